@@ -0,0 +1,112 @@
+/* bar_bench - time drawbar() style redraws through drw
+ *
+ * Draws the same segments as drawbar() in dwm.c: the tags, the layout
+ * symbol, the window title and the status text. Compares drw_text() on
+ * the persistent XftDraw of the Drw against the former behaviour of
+ * creating and destroying an XftDraw around every rendering call. Needs
+ * a running X server, e.g. Xvfb. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+
+#include "drw.h"
+#include "util.h"
+
+#define ROUNDS 2000
+#define BARW   1920
+
+static const char *fonts[] = { "monospace:size=12" };
+static const char *colors[] = { "#bbbbbb", "#222222", "#444444" };
+static const char *tags[] = { "1", "2", "3", "4", "5" };
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *s, int percall)
+{
+	XftDraw *d, *kept;
+
+	if (!percall)
+		return drw_text(drw, x, y, w, h, lpad, s, 0);
+	/* what every rendering drw_text() used to pay: Xft only creates the
+	 * Render Picture once something is drawn, so draw through it */
+	d = XftDrawCreate(drw->dpy, drw->drawable, DefaultVisual(drw->dpy, drw->screen),
+	                  DefaultColormap(drw->dpy, drw->screen));
+	kept = drw->xftdraw;
+	drw->xftdraw = d;
+	x = drw_text(drw, x, y, w, h, lpad, s, 0);
+	drw->xftdraw = kept;
+	XftDrawDestroy(d);
+	return x;
+}
+
+static void
+bar(Drw *drw, int bh, int percall)
+{
+	const char *status = "vol 40% | bat 87% | Sat Oct 17 12:00";
+	unsigned int i, w, lrpad = drw->fonts->h;
+	int x = 0;
+
+	for (i = 0; i < LENGTH(tags); i++) {
+		w = drw_fontset_getwidth(drw, tags[i]) + lrpad;
+		text(drw, x, 0, w, bh, lrpad / 2, tags[i], percall);
+		x += w;
+	}
+	w = drw_fontset_getwidth(drw, "[]=") + lrpad;
+	x = text(drw, x, 0, w, bh, lrpad / 2, "[]=", percall);
+	w = drw_fontset_getwidth(drw, status) + 2;
+	text(drw, BARW - w, 0, w, bh, 0, status, percall);
+	text(drw, x, 0, BARW - w - x, bh, lrpad / 2, "st - ~/src/dwm", percall);
+	drw_map(drw, drw->root, 0, 0, BARW, bh);
+}
+
+int
+main(void)
+{
+	Display *dpy;
+	Drw *drw;
+	unsigned int r;
+	int bh, screen;
+	double t0, tpercall, tkept;
+
+	if (!(dpy = XOpenDisplay(NULL)))
+		die("bar_bench: cannot open display");
+	screen = DefaultScreen(dpy);
+	drw = drw_create(dpy, screen, RootWindow(dpy, screen), BARW, 64);
+	if (!drw_fontset_create(drw, fonts, LENGTH(fonts)))
+		die("no fonts could be loaded.");
+	drw_setscheme(drw, drw_scm_create(drw, colors, LENGTH(colors)));
+	bh = drw->fonts->h + 2;
+
+	/* warm the glyph cache and the server side font */
+	bar(drw, bh, 0);
+	XSync(dpy, False);
+
+	t0 = now();
+	for (r = 0; r < ROUNDS; r++)
+		bar(drw, bh, 1);
+	XSync(dpy, False);
+	tpercall = now() - t0;
+
+	t0 = now();
+	for (r = 0; r < ROUNDS; r++)
+		bar(drw, bh, 0);
+	XSync(dpy, False);
+	tkept = now() - t0;
+
+	printf("bar redraw: XftDraw per call %8.1f us  kept %8.1f us\n",
+		tpercall * 1e6 / ROUNDS, tkept * 1e6 / ROUNDS);
+
+	drw_free(drw);
+	XCloseDisplay(dpy);
+	return 0;
+}
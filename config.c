@@ -1,13 +1,16 @@
 #include <X11/keysym.h>
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <confuse.h>
 
 #include "util.h"
+#include "keys.h"
 #include "dat.h"
 #include "fns.h"
-#include "keys.h"
+#include "rules.h"
 
 static int parsefunc(cfg_t *, cfg_opt_t *, const char *, void *);
 static int parselayout(cfg_t *, cfg_opt_t *, const char *, void *);
@@ -23,6 +26,10 @@ static void loadlayout(cfg_t *cfg);
 static void loadtags(cfg_t *cfg);
 static void loadrules(cfg_t *cfg);
 static void loadkeys(cfg_t *cfg);
+static int loadmodekeys(cfg_t *cfg, int mode, Key *keys);
+static int checkmodekeys(cfg_t *cfg, cfg_t *sec);
+static void trieinsert(KeyNode **level, const Key *k);
+static void triefree(KeyNode *n);
 static void loadbuttons(cfg_t *cfg);
 
 static Arg ploadarg(cfg_t *cfg);
@@ -70,6 +77,8 @@ loadconfig(const char *path)
 		CFG_BOOL("resizehints", 0, CFGF_NODEFAULT),
 		CFG_BOOL("lockfullscreen", 0, CFGF_NODEFAULT),
 		CFG_INT("refreshrate", 0, CFGF_NODEFAULT),
+		CFG_BOOL("iconify", 0, CFGF_NONE),
+		CFG_INT("chordtimeout", 0, CFGF_NONE),
 		CFG_END(),
 	};
 	static cfg_opt_t rule_opts[] = {
@@ -88,6 +97,11 @@ loadconfig(const char *path)
 		CFG_INT("i", 0, CFGF_NODEFAULT), 
 		CFG_FLOAT("f", 0.0, CFGF_NODEFAULT),
 		CFG_PTR_CB("layout", NULL, CFGF_NODEFAULT, parselayout, NULL),
+		CFG_STR("mode", NULL, CFGF_NODEFAULT),
+		CFG_END(),
+	};
+	static cfg_opt_t mode_opts[] = {
+		CFG_SEC("key", keys_opts, CFGF_MULTI),
 		CFG_END(),
 	};
 	static cfg_opt_t button_opts[] = {
@@ -106,6 +120,7 @@ loadconfig(const char *path)
 		CFG_STR_LIST("tags", NULL, CFGF_NODEFAULT),
 		CFG_SEC("rule", rule_opts, CFGF_MULTI),
 		CFG_SEC("key", keys_opts, CFGF_MULTI),
+		CFG_SEC("mode", mode_opts, CFGF_MULTI | CFGF_TITLE),
 		CFG_SEC("button", button_opts, CFGF_MULTI),
 		CFG_FUNC("include", &cfg_include),
 		CFG_END(),
@@ -113,22 +128,39 @@ loadconfig(const char *path)
 
 	static cfg_t *cfg = NULL;
 
-	if(cfg) {
-		cfg_free(cfg);
-		cfg = NULL;
+	/* the current config points into cfg, keep both if this one is bad */
+	cfg_t *next = cfg_init(config_opts, CFGF_NONE);
+	if(!next || cfg_parse(next, path) == CFG_PARSE_ERROR) {
+		perror("cfg_parse");
+		if(next)
+			cfg_free(next);
+		return;
 	}
 
-	cfg = cfg_init(config_opts, CFGF_NONE);
-	if(!cfg || cfg_parse(cfg, path) == CFG_PARSE_ERROR) {
-		perror("cfg_parse");
+	/* mode names are only known once everything is parsed */
+	int moderr = checkmodekeys(next, next);
+	for(int i = 0; i < cfg_size(next, "mode"); i++)
+		moderr |= checkmodekeys(next, cfg_getnsec(next, "mode", i));
+	if(moderr) {
+		cfg_free(next);
 		return;
 	}
 
+	if(cfg)
+		cfg_free(cfg);
+	cfg = next;
+
 	if(currentconfig) {
 		free(currentconfig->appearance.fonts);
 		free(currentconfig->tags);
 		free(currentconfig->rules);
+		rules_free(currentconfig->ruleset);
+		flushrulecache();
 		free(currentconfig->keys);
+		for(int i = 0; i < currentconfig->modescount; i++)
+			triefree(currentconfig->keytries[i]);
+		free(currentconfig->keytries);
+		free(currentconfig->modes);
 		free(currentconfig);
 	}
 	currentconfig = malloc(sizeof(*currentconfig));
@@ -175,6 +207,8 @@ loadlayout(cfg_t *sec)
 	currentconfig->lsettings.resizehints    = cfg_getbool(sec, "resizehints");
 	currentconfig->lsettings.lockfullscreen = cfg_getbool(sec, "lockfullscreen");
 	currentconfig->lsettings.refreshrate    = cfg_getint(sec, "refreshrate");
+	currentconfig->lsettings.iconify        = cfg_getbool(sec, "iconify");
+	currentconfig->lsettings.chordtimeout   = cfg_getint(sec, "chordtimeout");
 }
 
 void
@@ -192,6 +226,7 @@ void
 loadrules(cfg_t *sec)
 {
 	currentconfig->rules = NULL;
+	currentconfig->ruleset = NULL;
 	currentconfig->rulescount = cfg_size(sec, "rule");
 	if(currentconfig->rulescount == 0)
 		return;
@@ -209,28 +244,127 @@ loadrules(cfg_t *sec)
 		r->monitor    = cfg_getint(rsec, "monitor");
 		r->isfloating = cfg_getbool(rsec, "floating");
 	}
+
+	const char *(*pats)[RuleFields] = ecalloc(currentconfig->rulescount, sizeof(*pats));
+	for(int i = 0; i < currentconfig->rulescount; i++) {
+		pats[i][RuleClass]    = currentconfig->rules[i].class;
+		pats[i][RuleInstance] = currentconfig->rules[i].instance;
+		pats[i][RuleTitle]    = currentconfig->rules[i].title;
+	}
+	currentconfig->ruleset = rules_compile(pats, currentconfig->rulescount);
+	free(pats);
 }
 
 void
 loadkeys(cfg_t *sec)
 {
-	currentconfig->keys = NULL;
+	int nmodes = cfg_size(sec, "mode");
+
+	currentconfig->modescount = nmodes + 1;
+	currentconfig->modes = ecalloc(nmodes + 1, sizeof(currentconfig->modes[0]));
+	currentconfig->modes[0] = "default";
 	currentconfig->keyscount = cfg_size(sec, "key");
-	if(currentconfig->keyscount == 0)
-		return;
+	for(int i = 0; i < nmodes; i++) {
+		cfg_t *msec = cfg_getnsec(sec, "mode", i);
+		currentconfig->modes[i + 1] = cfg_title(msec);
+		currentconfig->keyscount += cfg_size(msec, "key");
+	}
+
+	currentconfig->keys = ecalloc(MAX(currentconfig->keyscount, 1), sizeof(currentconfig->keys[0]));
+	int n = loadmodekeys(sec, 0, currentconfig->keys);
+	for(int i = 0; i < nmodes; i++)
+		n += loadmodekeys(cfg_getnsec(sec, "mode", i), i + 1, currentconfig->keys + n);
 
-	currentconfig->keys = ecalloc(currentconfig->keyscount, sizeof(currentconfig->keys[0]));
+	currentconfig->keytries = ecalloc(currentconfig->modescount, sizeof(currentconfig->keytries[0]));
 	for(int i = 0; i < currentconfig->keyscount; i++) {
 		Key *k = currentconfig->keys + i;
+		trieinsert(&currentconfig->keytries[k->mode], k);
+	}
+}
+
+int
+loadmodekeys(cfg_t *sec, int mode, Key *keys)
+{
+	int count = cfg_size(sec, "key");
+
+	for(int i = 0; i < count; i++) {
+		Key *k = keys + i;
 
 		cfg_t *ksec = cfg_getnsec(sec, "key", i);
-		KeySymbol *ks = cfg_getptr(ksec, "bind");
+		KeyChord *kc = cfg_getptr(ksec, "bind");
 
-		k->keysym = ks->sym;
-		k->mod    = ks->mod;
+		k->chord = *kc;
+		k->mode  = mode;
 
 		k->func = (void(*)(const Arg*))cfg_getptr(ksec, "func");
 		k->arg  = ploadarg(ksec);
+
+		/* setmode target, the top level if not given; known to exist,
+		 * see checkmodekeys() */
+		if(cfg_size(ksec, "mode") > 0) {
+			const char *name = cfg_getstr(ksec, "mode");
+			k->arg.i = 0;
+			for(int j = 0; j < currentconfig->modescount; j++)
+				if(strcmp(currentconfig->modes[j], name) == 0)
+					k->arg.i = j;
+		}
+	}
+	return count;
+}
+
+/* report setmode targets naming no mode section */
+int
+checkmodekeys(cfg_t *cfg, cfg_t *sec)
+{
+	int err = 0;
+
+	for(int i = 0; i < cfg_size(sec, "key"); i++) {
+		cfg_t *ksec = cfg_getnsec(sec, "key", i);
+
+		if(cfg_size(ksec, "mode") == 0)
+			continue;
+		const char *name = cfg_getstr(ksec, "mode");
+		if(strcmp(name, "default") != 0 && !cfg_gettsec(cfg, "mode", name)) {
+			cfg_error(ksec, "unknown mode '%s'", name);
+			err = 1;
+		}
+	}
+	return err;
+}
+
+/* add the chord of k below level; prefixes are shared, bindings are not */
+void
+trieinsert(KeyNode **level, const Key *k)
+{
+	for(int i = 0; i < k->chord.len; i++) {
+		const KeySymbol *ks = &k->chord.keys[i];
+		int last = i == k->chord.len - 1;
+		KeyNode *n, **p;
+
+		for(p = level; (n = *p); p = &n->next)
+			if(!last && !n->key && n->mod == ks->mod && n->keysym == ks->sym)
+				break;
+		if(!n) {
+			n = ecalloc(1, sizeof(*n));
+			n->mod    = ks->mod;
+			n->keysym = ks->sym;
+			*p = n;
+		}
+		if(last)
+			n->key = k;
+		level = &n->child;
+	}
+}
+
+void
+triefree(KeyNode *n)
+{
+	KeyNode *next;
+
+	for(; n; n = next) {
+		next = n->next;
+		triefree(n->child);
+		free(n);
 	}
 }
 
@@ -285,6 +419,8 @@ parsefunc(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
 		FN(resizemouse),
 		FN(quit),
 		FN(restart),
+		FN(dumpstats),
+		FN(setmode),
 #undef FN
 	};
 
@@ -338,10 +474,10 @@ ploadarg(cfg_t *sec)
 int 
 parsekey(cfg_t *cfg, cfg_opt_t *opt, const char *value, void *result)
 {
-	KeySymbol *ks = ecalloc(1, sizeof(*ks));
-	*ks = parse_keysymbol(value);
-	*(void**)result = ks;
-	return ks->error;
+	KeyChord *kc = ecalloc(1, sizeof(*kc));
+	*kc = parse_keychord(value);
+	*(void**)result = kc;
+	return kc->error;
 }
 
 int 
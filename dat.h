@@ -5,11 +5,15 @@
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
 enum { SchemeNorm, SchemeSel, LASTScheme }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
-       NetWMFullscreen, NetActiveWindow, NetWMWindowType,
+       NetWMFullscreen, NetWMHidden, NetActiveWindow, NetWMWindowType,
        NetWMWindowTypeDialog, NetClientList, NetLast }; /* EWMH atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { PendingDraw = 1 << 0, PendingArrange = 1 << 1 }; /* deferred monitor work */
+enum { ButtonsNone, ButtonsUnfocused, ButtonsFocused }; /* Client.buttons */
+enum { CellInvert = 1 << 0, CellBox = 1 << 1, CellBoxFilled = 1 << 2,
+       CellEmpty = 1 << 3 }; /* BarCell.flags */
 
 typedef union {
 	int i;
@@ -28,28 +32,124 @@ typedef struct {
 
 typedef struct Monitor Monitor;
 typedef struct Client Client;
+
+/* what layouts, focus and ISVISIBLE touch comes first, so that list walks
+ * stay within the first two cache lines of each node; the title, hints and
+ * saved state only manage(), property changes and fullscreen read follow */
 struct Client {
-	char name[256];
-	float mina, maxa;
-	int x, y, w, h;
-	int oldx, oldy, oldw, oldh;
-	int basew, baseh, incw, inch, maxw, maxh, minw, minh, hintsvalid;
-	int bw, oldbw;
 	unsigned int tags;
-	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
-	Client *next;
-	Client *snext;
+	unsigned int isfixed:1, isfloating:1, isurgent:1, neverfocus:1, isfullscreen:1;
+	unsigned int hintsvalid:1, hashints:1; /* hashints: has size limits */
+	unsigned int shown:1;  /* window is at x, y rather than off screen */
+	unsigned int iconic:1; /* unmapped by hideclient(), see lsettings.iconify */
+	unsigned int buttons:2; /* grabs set up by grabbuttons() */
 	Monitor *mon;
+	Client *next, *prev;   /* clients list */
+	Client *snext, *sprev; /* focus stack */
+	Client *vnext, *vprev; /* visible part of clients */
+	Client *vsnext, *vsprev; /* visible part of stack */
+	int x, y, w, h;
+	int bw;
 	Window win;
+
+	char name[256];
+	float mina, maxa;
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
+	int oldx, oldy, oldw, oldh;
+	int oldbw, oldstate;
+	int ignoreunmap;      /* UnmapNotify events caused by hideclient() */
 };
 
+/* window properties read by manage(), see fetchprops() */
 typedef struct {
-	unsigned int mod;
-	KeySym keysym;
+	char name[256];
+	char class[256], instance[256];
+	int hasclass;
+	Window trans;
+	Atom state, wtype;
+	XSizeHints size;
+	XWMHints wmh;
+	int haswmh;
+} Props;
+
+/* a pre-existing window as seen by scan(), see scanwins() */
+typedef struct {
+	XWindowAttributes wa;
+	int valid;            /* wa could be read */
+	int istrans;          /* has WM_TRANSIENT_FOR */
+	long state;           /* WM_STATE, -1 if unset */
+} ScanWin;
+
+typedef struct {
+	Window win;
+	Client *c;            /* client owning win, or NULL */
+	Monitor *m;           /* monitor whose barwin is win, or NULL */
+} WinEntry;
+
+/* applyrules() result for a class and instance, see rulecache */
+typedef struct {
+	char *class, *instance; /* NULL if the slot is empty */
+	unsigned int tags;
+	int isfloating;
+	int mon;              /* Monitor.num, or -1 */
+} RuleCache;
+
+/* a part of the bar starting at x, up to the next one */
+typedef struct {
+	int x;
+	unsigned int click;   /* Clk* */
+	unsigned int tag;     /* index, for ClkTagBar */
+} BarSeg;
+
+/* what a part of the bar pixmap shows, see barcell() */
+typedef struct {
+	int x, w;
+	int scheme;           /* Scheme* */
+	unsigned int flags;   /* Cell* */
+	int dirty;            /* drawn but not yet copied to the barwin */
+	char text[256];
+} BarCell;
+
+/* target geometry of a tiled client, see place() */
+typedef struct {
+	Client *c;
+	int x, y, w, h;
+} Geom;
+
+typedef struct {
+	KeyChord chord;       /* keys pressed in turn, see keys.h */
+	int mode;             /* index into Config.modes */
 	void (*func)(const Arg *);
 	Arg arg;
 } Key;
 
+/* one step of the key bindings of a mode, see loadkeys() */
+typedef struct KeyNode KeyNode;
+struct KeyNode {
+	unsigned int mod;
+	KeySym keysym;
+	const Key *key;       /* binding ending here, NULL if a chord goes on */
+	KeyNode *child;       /* keys that may follow, if key is NULL */
+	KeyNode *next;        /* other keys at this step */
+};
+
+typedef struct {
+	KeySym sym;
+	KeyCode code;
+} KeyMap;
+
+/* a passive key grab on root, see grabkeys() */
+typedef struct {
+	unsigned int mod;
+	KeyCode code;
+} Grab;
+
+/* a first key of the current mode, by keycode, see grabkeys() */
+typedef struct {
+	unsigned int mod;     /* CLEANMASK()ed */
+	const KeyNode *node;
+} KeyEntry;
+
 typedef struct {
 	const char *symbol;
 	void (*arrange)(Monitor *);
@@ -68,11 +168,25 @@ struct Monitor {
 	unsigned int tagset[2];
 	int showbar;
 	int topbar;
+	unsigned int pending; /* work deferred to the end of the event batch */
+	unsigned int occ, urg;       /* tags with any/urgent clients */
+	unsigned int ntagged[32];    /* clients per tag */
+	unsigned int nurgent[32];    /* urgent clients per tag */
 	Client *clients;
 	Client *sel;
 	Client *stack;
+	Client *vis;                 /* clients on the selected tags, in order */
+	Client *vstack;              /* same in focus order */
+	Geom *geom;                  /* targets of the last arrange, see place() */
+	unsigned int ngeom, geomsize;
+	BarSeg *segs;                /* bar layout of the last drawbar() */
+	unsigned int nsegs, segssize;
+	BarCell *cells;              /* tags, layout symbol, title and status */
 	Monitor *next;
 	Window barwin;
+	Pixmap barpix;               /* back buffer of barwin, barpixw wide */
+	int barpixw;
+	int barvalid;                /* cells describe what barpix holds */
 	const Layout *lt[2];
 };
 
@@ -103,6 +217,8 @@ typedef struct {
 		int resizehints;
 		int lockfullscreen;
 		int refreshrate;
+		int iconify;     /* unmap clients on hidden tags */
+		int chordtimeout; /* ms to wait for the next key of a chord, 0 forever */
 	} lsettings;
 
 	char **tags;
@@ -110,9 +226,13 @@ typedef struct {
 
 	Rule *rules;
 	int   rulescount;
+	struct RuleSet *ruleset; /* rules compiled by rules_compile() */
 
 	Key *keys;
 	int  keyscount;
+	const char **modes;   /* names, modes[0] is the top level */
+	int  modescount;
+	KeyNode **keytries;   /* bindings of each mode */
 
 	Button *buttons;
 	int     buttonscount;
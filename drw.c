@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
 
@@ -9,6 +10,7 @@
 #include "util.h"
 
 #define UTF_INVALID 0xFFFD
+#define FALLBACK_MAGIC "dwm fallback 1"
 
 static int
 utf8decode(const char *s_in, long *u, int *err)
@@ -46,6 +48,228 @@ utf8decode(const char *s_in, long *u, int *err)
 	return len;
 }
 
+static unsigned int
+glyphhash(long cp)
+{
+	unsigned int hash = (unsigned int)cp;
+
+	hash = ((hash >> 16) ^ hash) * 0x21F0AAAD;
+	hash = ((hash >> 15) ^ hash) * 0xD35A2D97;
+	return (hash >> 15) ^ hash;
+}
+
+/* forget every cached glyph, the fontset changed */
+static void
+glyph_reset(Drw *drw)
+{
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(drw->latin1); i++)
+		drw->latin1[i].cp = -1;
+	for (i = 0; i < drw->glyphssize; i++)
+		drw->glyphs[i].cp = -1;
+	drw->nglyphs = 0;
+}
+
+/* font has been appended to the fontset: codepoints no font had so far
+ * may be in it */
+static void
+glyph_addfont(Drw *drw, Fnt *font)
+{
+	XGlyphInfo ext;
+	FcChar32 c;
+	Advance *g;
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(drw->latin1) + drw->glyphssize; i++) {
+		g = i < LENGTH(drw->latin1) ? &drw->latin1[i] : &drw->glyphs[i - LENGTH(drw->latin1)];
+		if (g->cp < 0 || g->font || !XftCharExists(drw->dpy, font->xfont, g->cp))
+			continue;
+		c = g->cp;
+		XftTextExtents32(drw->dpy, font->xfont, &c, 1, &ext);
+		g->font = font;
+		g->w = ext.xOff;
+	}
+}
+
+static Advance *
+glyph_get(Drw *drw, long cp)
+{
+	XGlyphInfo ext;
+	FcChar32 c = cp;
+	Advance *g, *old;
+	Fnt *f;
+	unsigned int i, n;
+
+	if (cp >= 0 && cp < LENGTH(drw->latin1)) {
+		g = &drw->latin1[cp];
+	} else {
+		if (4 * (drw->nglyphs + 1) > 3 * drw->glyphssize) {
+			old = drw->glyphs;
+			n = drw->glyphssize;
+			drw->glyphssize = n ? 2 * n : 256;
+			drw->glyphs = ecalloc(drw->glyphssize, sizeof(Advance));
+			for (i = 0; i < drw->glyphssize; i++)
+				drw->glyphs[i].cp = -1;
+			for (i = 0; i < n; i++) {
+				if (old[i].cp < 0)
+					continue;
+				for (g = &drw->glyphs[glyphhash(old[i].cp) & (drw->glyphssize - 1)];
+				     g->cp >= 0;
+				     g = g + 1 < drw->glyphs + drw->glyphssize ? g + 1 : drw->glyphs);
+				*g = old[i];
+			}
+			free(old);
+		}
+		for (g = &drw->glyphs[glyphhash(cp) & (drw->glyphssize - 1)];
+		     g->cp >= 0 && g->cp != cp;
+		     g = g + 1 < drw->glyphs + drw->glyphssize ? g + 1 : drw->glyphs);
+		if (g->cp < 0)
+			drw->nglyphs++;
+	}
+	if (g->cp == cp)
+		return g;
+
+	for (f = drw->fonts; f && !XftCharExists(drw->dpy, f->xfont, c); f = f->next);
+	XftTextExtents32(drw->dpy, (f ? f : drw->fonts)->xfont, &c, 1, &ext);
+	g->cp = cp;
+	g->font = f;
+	g->w = ext.xOff;
+	return g;
+}
+
+static void
+fallback_clear(Drw *drw)
+{
+	unsigned int i;
+
+	for (i = 0; i < drw->fallbackssize; i++)
+		free(drw->fallbacks[i].name);
+	free(drw->fallbacks);
+	drw->fallbacks = NULL;
+	drw->nfallbacks = drw->fallbackssize = 0;
+}
+
+static Fallback *
+fallback_find(Drw *drw, long cp)
+{
+	Fallback *fb;
+
+	if (!drw->fallbackssize)
+		return NULL;
+	for (fb = &drw->fallbacks[glyphhash(cp) & (drw->fallbackssize - 1)];
+	     fb->cp >= 0 && fb->cp != cp;
+	     fb = fb + 1 < drw->fallbacks + drw->fallbackssize ? fb + 1 : drw->fallbacks);
+	return fb->cp == cp ? fb : NULL;
+}
+
+/* records name, which is taken over, as the fallback for cp */
+static void
+fallback_set(Drw *drw, long cp, char *name)
+{
+	Fallback *fb, *old;
+	unsigned int i, n;
+
+	if ((fb = fallback_find(drw, cp))) {
+		free(fb->name);
+		fb->name = name;
+		drw->fallbacksdirty = 1;
+		return;
+	}
+	if (4 * (drw->nfallbacks + 1) > 3 * drw->fallbackssize) {
+		old = drw->fallbacks;
+		n = drw->fallbackssize;
+		drw->fallbackssize = n ? 2 * n : 1024;
+		drw->fallbacks = ecalloc(drw->fallbackssize, sizeof(Fallback));
+		for (i = 0; i < drw->fallbackssize; i++)
+			drw->fallbacks[i].cp = -1;
+		drw->nfallbacks = 0;
+		for (i = 0; i < n; i++)
+			if (old[i].cp >= 0)
+				fallback_set(drw, old[i].cp, old[i].name);
+		free(old);
+	}
+	for (fb = &drw->fallbacks[glyphhash(cp) & (drw->fallbackssize - 1)];
+	     fb->cp >= 0;
+	     fb = fb + 1 < drw->fallbacks + drw->fallbackssize ? fb + 1 : drw->fallbacks);
+	fb->cp = cp;
+	fb->name = name;
+	drw->nfallbacks++;
+	drw->fallbacksdirty = 1;
+}
+
+/* the expensive part of the fallback: ask fontconfig for a font with cp */
+static FcPattern *
+fallback_match(Drw *drw, long cp)
+{
+	FcCharSet *fccharset;
+	FcPattern *fcpattern, *match;
+	XftResult result;
+
+	fccharset = FcCharSetCreate();
+	FcCharSetAddChar(fccharset, cp);
+
+	if (!drw->fonts->pattern) {
+		/* Refer to the comment in xfont_create for more information. */
+		die("the first font in the cache must be loaded from a font string.");
+	}
+
+	fcpattern = FcPatternDuplicate(drw->fonts->pattern);
+	FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
+	FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
+
+	FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
+	FcDefaultSubstitute(fcpattern);
+	match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
+
+	FcCharSetDestroy(fccharset);
+	FcPatternDestroy(fcpattern);
+
+	return match;
+}
+
+/* match as a font name that XftFontOpenPattern() takes without another
+ * match; only the charset and languages, which would dwarf the rest and
+ * are not needed to open the font, are left out */
+static char *
+fallback_unparse(FcPattern *match)
+{
+	FcPattern *p;
+	FcChar8 *name;
+
+	if (!(p = FcPatternDuplicate(match)))
+		return NULL;
+	FcPatternDel(p, FC_CHARSET);
+	FcPatternDel(p, FC_LANG);
+	name = FcNameUnparse(p);
+	FcPatternDestroy(p);
+	return (char *)name;
+}
+
+/* latest change to the fontconfig configuration or font directories,
+ * as FcConfigUptoDate() sees it */
+static long long
+fcconfigtime(void)
+{
+	FcStrList *lists[2];
+	FcChar8 *f;
+	struct stat st;
+	long long t = 0;
+	unsigned int i;
+
+	lists[0] = FcConfigGetConfigFiles(NULL);
+	lists[1] = FcConfigGetFontDirs(NULL);
+	for (i = 0; i < LENGTH(lists); i++) {
+		if (!lists[i])
+			continue;
+		while ((f = FcStrListNext(lists[i])))
+			if (!stat((char *)f, &st) && st.st_mtime > t)
+				t = st.st_mtime;
+		FcStrListDone(lists[i]);
+	}
+	return t;
+}
+
 Drw *
 drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h)
 {
@@ -56,9 +280,12 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->root = root;
 	drw->w = w;
 	drw->h = h;
-	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+	drw->drawable = drw->pixmap = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
+	drw->xftdraw = drw->pixmapdraw = XftDrawCreate(dpy, drw->pixmap, DefaultVisual(dpy, screen),
+	                                               DefaultColormap(dpy, screen));
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
+	glyph_reset(drw);
 
 	return drw;
 }
@@ -71,17 +298,31 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 
 	drw->w = w;
 	drw->h = h;
-	if (drw->drawable)
-		XFreePixmap(drw->dpy, drw->drawable);
-	drw->drawable = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	if (drw->pixmapdraw)
+		XftDrawDestroy(drw->pixmapdraw);
+	if (drw->pixmap)
+		XFreePixmap(drw->dpy, drw->pixmap);
+	drw->drawable = drw->pixmap = XCreatePixmap(drw->dpy, drw->root, w, h, DefaultDepth(drw->dpy, drw->screen));
+	drw->xftdraw = drw->pixmapdraw = XftDrawCreate(drw->dpy, drw->pixmap,
+	                                               DefaultVisual(drw->dpy, drw->screen),
+	                                               DefaultColormap(drw->dpy, drw->screen));
 }
 
 void
 drw_free(Drw *drw)
 {
-	XFreePixmap(drw->dpy, drw->drawable);
+	unsigned int i;
+
+	for (i = 0; i < drw->ntargets; i++)
+		XftDrawDestroy(drw->targets[i].xftdraw);
+	free(drw->targets);
+	XftDrawDestroy(drw->pixmapdraw);
+	XFreePixmap(drw->dpy, drw->pixmap);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	free(drw->glyphs);
+	fallback_clear(drw);
+	free(drw->fontskey);
 	free(drw);
 }
 
@@ -143,17 +384,41 @@ Fnt*
 drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 {
 	Fnt *cur, *ret = NULL;
-	size_t i;
+	size_t i, len;
+	char *key;
+	long long fctime;
 
 	if (!drw || !fonts)
 		return NULL;
 
+	/* fonts installed since fontconfig was loaded are seen from here on,
+	 * and the fallbacks are only good for the setup they were found with */
+	if (!FcConfigUptoDate(NULL))
+		FcInitReinitialize();
+	fctime = fcconfigtime();
+
 	for (i = 1; i <= fontcount; i++) {
 		if ((cur = xfont_create(drw, fonts[fontcount - i], NULL))) {
 			cur->next = ret;
 			ret = cur;
 		}
 	}
+	glyph_reset(drw);
+
+	/* fallbacks found for another fontset or setup do not apply */
+	for (i = len = 0; i < fontcount; i++)
+		len += strlen(fonts[i]) + 1;
+	key = ecalloc(1, len + 1);
+	for (i = 0; i < fontcount; i++) {
+		strcat(key, fonts[i]);
+		strcat(key, "\t");
+	}
+	if (!drw->fontskey || strcmp(drw->fontskey, key) || drw->fctime != fctime)
+		fallback_clear(drw);
+	free(drw->fontskey);
+	drw->fontskey = key;
+	drw->fctime = fctime;
+
 	return (drw->fonts = ret);
 }
 
@@ -197,11 +462,73 @@ drw_scm_create(Drw *drw, const char *clrnames[], size_t clrcount)
 	return ret;
 }
 
+/* keep an XftDraw for d, which stays owned by the caller, so switching
+ * to it with drw_setdrawable() costs nothing. d must have the depth and
+ * visual of the root window. */
+void
+drw_adddrawable(Drw *drw, Drawable d)
+{
+	unsigned int i;
+
+	if (!drw || d == drw->pixmap)
+		return;
+	for (i = 0; i < drw->ntargets; i++)
+		if (drw->targets[i].drawable == d)
+			return;
+	if (!(drw->targets = realloc(drw->targets, (drw->ntargets + 1) * sizeof(Target))))
+		die("realloc:");
+	drw->targets[drw->ntargets].drawable = d;
+	drw->targets[drw->ntargets++].xftdraw = XftDrawCreate(drw->dpy, d,
+		DefaultVisual(drw->dpy, drw->screen), DefaultColormap(drw->dpy, drw->screen));
+}
+
+/* forget d before the caller frees it */
+void
+drw_deldrawable(Drw *drw, Drawable d)
+{
+	unsigned int i;
+
+	if (!drw)
+		return;
+	for (i = 0; i < drw->ntargets; i++)
+		if (drw->targets[i].drawable == d) {
+			XftDrawDestroy(drw->targets[i].xftdraw);
+			drw->targets[i] = drw->targets[--drw->ntargets];
+			break;
+		}
+	if (drw->drawable == d && d != drw->pixmap) {
+		drw->drawable = drw->pixmap;
+		drw->xftdraw = drw->pixmapdraw;
+	}
+}
+
+/* draw into d instead of the own pixmap, adding it if needed */
+void
+drw_setdrawable(Drw *drw, Drawable d)
+{
+	unsigned int i;
+
+	if (!drw || drw->drawable == d)
+		return;
+	if (d == drw->pixmap) {
+		drw->drawable = drw->pixmap;
+		drw->xftdraw = drw->pixmapdraw;
+		return;
+	}
+	for (i = 0; i < drw->ntargets && drw->targets[i].drawable != d; i++);
+	if (i == drw->ntargets)
+		drw_adddrawable(drw, d);
+	drw->drawable = d;
+	drw->xftdraw = drw->targets[i].xftdraw;
+}
+
 void
 drw_setfontset(Drw *drw, Fnt *set)
 {
-	if (drw)
+	if (drw && drw->fonts != set) {
 		drw->fonts = set;
+		glyph_reset(drw);
+	}
 }
 
 void
@@ -227,19 +554,18 @@ int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
 	int ty, ellipsis_x = 0;
-	unsigned int tmpw, ew, ellipsis_w = 0, ellipsis_len, hash, h0, h1;
-	XftDraw *d = NULL;
+	unsigned int tmpw, ew, ellipsis_w = 0, ellipsis_len;
 	Fnt *usedfont, *curfont, *nextfont;
 	int utf8strlen, utf8charlen, utf8err, render = x || y || w || h;
 	long utf8codepoint = 0;
 	const char *utf8str;
-	FcCharSet *fccharset;
-	FcPattern *fcpattern;
 	FcPattern *match;
-	XftResult result;
+	Fallback *fb;
+	Fnt *newfont;
+	char *name;
+	Advance *g;
 	int charexists = 0, overflow = 0;
-	/* keep track of a couple codepoints for which we have no match. */
-	static unsigned int nomatches[128], ellipsis_width, invalid_width;
+	static unsigned int ellipsis_width, invalid_width;
 	static const char invalid[] = "�";
 
 	if (!drw || (render && (!drw->scheme || !w)) || !text || !drw->fonts)
@@ -252,9 +578,6 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		XFillRectangle(drw->dpy, drw->drawable, drw->gc, x, y, w, h);
 		if (w < lpad)
 			return x + w;
-		d = XftDrawCreate(drw->dpy, drw->drawable,
-		                  DefaultVisual(drw->dpy, drw->screen),
-		                  DefaultColormap(drw->dpy, drw->screen));
 		x += lpad;
 		w -= lpad;
 	}
@@ -270,34 +593,35 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		nextfont = NULL;
 		while (*text) {
 			utf8charlen = utf8decode(text, &utf8codepoint, &utf8err);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
-				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
-				if (charexists) {
-					drw_font_getexts(curfont, text, utf8charlen, &tmpw, NULL);
-					if (ew + ellipsis_width <= w) {
-						/* keep track where the ellipsis still fits */
-						ellipsis_x = x + ew;
-						ellipsis_w = w - ew;
-						ellipsis_len = utf8strlen;
-					}
-
-					if (ew + tmpw > w) {
-						overflow = 1;
-						/* called from drw_fontset_getwidth_clamp():
-						 * it wants the width AFTER the overflow
-						 */
-						if (!render)
-							x += tmpw;
-						else
-							utf8strlen = ellipsis_len;
-					} else if (curfont == usedfont) {
-						text += utf8charlen;
-						utf8strlen += utf8err ? 0 : utf8charlen;
-						ew += utf8err ? 0 : tmpw;
-					} else {
-						nextfont = curfont;
-					}
-					break;
+			g = glyph_get(drw, utf8codepoint);
+			/* a font without the glyph is only used once the fallback
+			 * search failed, and then it is the first one */
+			charexists = charexists || g->font;
+			curfont = g->font ? g->font : drw->fonts;
+			if (charexists) {
+				tmpw = g->w;
+				if (ew + ellipsis_width <= w) {
+					/* keep track where the ellipsis still fits */
+					ellipsis_x = x + ew;
+					ellipsis_w = w - ew;
+					ellipsis_len = utf8strlen;
+				}
+
+				if (ew + tmpw > w) {
+					overflow = 1;
+					/* called from drw_fontset_getwidth_clamp():
+					 * it wants the width AFTER the overflow
+					 */
+					if (!render)
+						x += tmpw;
+					else
+						utf8strlen = ellipsis_len;
+				} else if (curfont == usedfont) {
+					text += utf8charlen;
+					utf8strlen += utf8err ? 0 : utf8charlen;
+					ew += utf8err ? 0 : tmpw;
+				} else {
+					nextfont = curfont;
 				}
 			}
 
@@ -310,7 +634,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		if (utf8strlen) {
 			if (render) {
 				ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-				XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
+				XftDrawStringUtf8(drw->xftdraw, &drw->scheme[invert ? ColBg : ColFg],
 				                  usedfont->xfont, x, ty, (XftChar8 *)utf8str, utf8strlen);
 			}
 			x += ew;
@@ -335,51 +659,35 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 			 * character must be drawn. */
 			charexists = 1;
 
-			hash = (unsigned int)utf8codepoint;
-			hash = ((hash >> 16) ^ hash) * 0x21F0AAAD;
-			hash = ((hash >> 15) ^ hash) * 0xD35A2D97;
-			h0 = ((hash >> 15) ^ hash) % LENGTH(nomatches);
-			h1 = (hash >> 17) % LENGTH(nomatches);
-			/* avoid expensive XftFontMatch call when we know we won't find a match */
-			if (nomatches[h0] == utf8codepoint || nomatches[h1] == utf8codepoint)
+			/* avoid expensive XftFontMatch call when we know the result */
+			fb = fallback_find(drw, utf8codepoint);
+			if (fb && !fb->name)
 				goto no_match;
-
-			fccharset = FcCharSetCreate();
-			FcCharSetAddChar(fccharset, utf8codepoint);
-
-			if (!drw->fonts->pattern) {
-				/* Refer to the comment in xfont_create for more information. */
-				die("the first font in the cache must be loaded from a font string.");
+			name = NULL;
+			newfont = NULL;
+			if (!fb || !(match = FcNameParse((FcChar8 *)fb->name))) {
+				if ((match = fallback_match(drw, utf8codepoint)))
+					name = fallback_unparse(match);
 			}
-
-			fcpattern = FcPatternDuplicate(drw->fonts->pattern);
-			FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
-			FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
-
-			FcConfigSubstitute(NULL, fcpattern, FcMatchPattern);
-			FcDefaultSubstitute(fcpattern);
-			match = XftFontMatch(drw->dpy, drw->screen, fcpattern, &result);
-
-			FcCharSetDestroy(fccharset);
-			FcPatternDestroy(fcpattern);
-
-			if (match) {
-				usedfont = xfont_create(drw, NULL, match);
-				if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
-					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
-						; /* NOP */
-					curfont->next = usedfont;
-				} else {
-					xfont_free(usedfont);
-					nomatches[nomatches[h0] ? h1 : h0] = utf8codepoint;
+			if (match && !(newfont = xfont_create(drw, NULL, match)))
+				FcPatternDestroy(match);
+
+			if (newfont && XftCharExists(drw->dpy, newfont->xfont, utf8codepoint)) {
+				for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
+					; /* NOP */
+				curfont->next = usedfont = newfont;
+				glyph_addfont(drw, usedfont);
+				if (name)
+					fallback_set(drw, utf8codepoint, name);
+			} else {
+				xfont_free(newfont);
+				free(name);
+				fallback_set(drw, utf8codepoint, NULL);
 no_match:
-					usedfont = drw->fonts;
-				}
+				usedfont = drw->fonts;
 			}
 		}
 	}
-	if (d)
-		XftDrawDestroy(d);
 
 	return x + (render ? w : 0);
 }
@@ -391,7 +699,6 @@ drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 		return;
 
 	XCopyArea(drw->dpy, drw->drawable, win, drw->gc, x, y, w, h, x, y);
-	XSync(drw->dpy, False);
 }
 
 unsigned int
@@ -426,6 +733,77 @@ drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w,
 		*h = font->h;
 }
 
+/* read the fallbacks saved by drw_fallback_save(), unless they were
+ * found for another fontset or fontconfig setup */
+void
+drw_fallback_load(Drw *drw, const char *path)
+{
+	FILE *fp;
+	char *line = NULL, *p;
+	size_t size = 0;
+	ssize_t len;
+	long cp;
+
+	if (!drw || !drw->fontskey || !path || !(fp = fopen(path, "r")))
+		return;
+	if ((len = getline(&line, &size, fp)) <= 0
+	|| strcmp(line, FALLBACK_MAGIC "\n")
+	|| (len = getline(&line, &size, fp)) <= 0
+	|| strtoll(line, NULL, 10) != drw->fctime
+	|| (len = getline(&line, &size, fp)) <= 0
+	|| strncmp(line, drw->fontskey, len - 1) || drw->fontskey[len - 1])
+		goto done;
+
+	while ((len = getline(&line, &size, fp)) > 0) {
+		if (line[len - 1] == '\n')
+			line[--len] = '\0';
+		cp = strtol(line, &p, 16);
+		if (p == line || cp < 0 || (*p && *p != ' '))
+			continue;
+		fallback_set(drw, cp, *p ? strdup(p + 1) : NULL);
+	}
+done:
+	drw->fallbacksdirty = 0;
+	free(line);
+	fclose(fp);
+}
+
+/* write the fallbacks, one codepoint and font name per line, after a
+ * header naming the fontset and fontconfig setup they are good for */
+void
+drw_fallback_save(Drw *drw, const char *path)
+{
+	FILE *fp;
+	char *tmp, *p;
+	unsigned int i;
+
+	if (!drw || !drw->fontskey || !path || !drw->fallbacksdirty)
+		return;
+
+	tmp = ecalloc(1, strlen(path) + 5);
+	sprintf(tmp, "%s.tmp", path);
+	/* create missing parents like mkdir -p, fopen() reports the rest */
+	for (p = tmp + 1; (p = strchr(p, '/')); *p++ = '/') {
+		*p = '\0';
+		mkdir(tmp, 0700);
+	}
+	if (!(fp = fopen(tmp, "w"))) {
+		free(tmp);
+		return;
+	}
+	fprintf(fp, FALLBACK_MAGIC "\n%lld\n%s\n", drw->fctime, drw->fontskey);
+	for (i = 0; i < drw->fallbackssize; i++)
+		if (drw->fallbacks[i].cp >= 0)
+			fprintf(fp, "%lx%s%s\n", drw->fallbacks[i].cp,
+			        drw->fallbacks[i].name ? " " : "",
+			        drw->fallbacks[i].name ? drw->fallbacks[i].name : "");
+	if (fclose(fp) == 0 && rename(tmp, path) == 0)
+		drw->fallbacksdirty = 0;
+	else
+		remove(tmp);
+	free(tmp);
+}
+
 Cur *
 drw_cur_create(Drw *drw, int shape)
 {
@@ -12,6 +12,25 @@ typedef struct Fnt {
 	struct Fnt *next;
 } Fnt;
 
+/* font and advance of a codepoint in the current fontset */
+typedef struct {
+	long cp;              /* -1 if the slot is unused */
+	Fnt *font;            /* first font with a glyph for cp, NULL if none */
+	unsigned int w;       /* advance in font, or in the first font if none */
+} Advance;
+
+/* fontconfig's fallback for a codepoint missing from the fontset */
+typedef struct {
+	long cp;              /* -1 if the slot is unused */
+	char *name;           /* unparsed pattern of the match, NULL if none */
+} Fallback;
+
+/* a drawable of the caller and the XftDraw kept for it */
+typedef struct {
+	Drawable drawable;
+	XftDraw *xftdraw;
+} Target;
+
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
@@ -20,10 +39,23 @@ typedef struct {
 	Display *dpy;
 	int screen;
 	Window root;
-	Drawable drawable;
+	Drawable drawable;    /* target of drawing and drw_map() */
+	XftDraw *xftdraw;     /* on drawable, kept across drw_text() calls */
+	Pixmap pixmap;        /* own, freed by drw_resize() and drw_free() */
+	XftDraw *pixmapdraw;
+	Target *targets;      /* see drw_adddrawable() */
+	unsigned int ntargets;
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	Advance latin1[256];  /* glyph cache, flat for U+0000 to U+00FF */
+	Advance *glyphs;      /* and open addressing for the rest */
+	unsigned int nglyphs, glyphssize;
+	Fallback *fallbacks;  /* open addressing, see drw_fallback_load() */
+	unsigned int nfallbacks, fallbackssize;
+	int fallbacksdirty;   /* changed since loaded or saved */
+	char *fontskey;       /* names of the fontset, tab separated */
+	long long fctime;     /* fontconfig setup the fallbacks were found with */
 } Drw;
 
 /* Drawable abstraction */
@@ -37,6 +69,8 @@ void drw_fontset_free(Fnt* set);
 unsigned int drw_fontset_getwidth(Drw *drw, const char *text);
 unsigned int drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n);
 void drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w, unsigned int *h);
+void drw_fallback_load(Drw *drw, const char *path);
+void drw_fallback_save(Drw *drw, const char *path);
 
 /* Colorscheme abstraction */
 void drw_clr_create(Drw *drw, Clr *dest, const char *clrname);
@@ -47,6 +81,9 @@ Cur *drw_cur_create(Drw *drw, int shape);
 void drw_cur_free(Drw *drw, Cur *cursor);
 
 /* Drawing context manipulation */
+void drw_adddrawable(Drw *drw, Drawable d);
+void drw_deldrawable(Drw *drw, Drawable d);
+void drw_setdrawable(Drw *drw, Drawable d);
 void drw_setfontset(Drw *drw, Fnt *set);
 void drw_setscheme(Drw *drw, Clr *scm);
 
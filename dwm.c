@@ -23,11 +23,13 @@
 #include <X11/X.h>
 #include <errno.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -41,11 +43,18 @@
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
 #include <X11/Xft/Xft.h>
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif /* XCB */
 
 #include "drw.h"
 #include "util.h"
+#include "rules.h"
+#include "keys.h"
 
 /* macros */
+#define BATCHSIZE               256 /* max events drained by run() at once */
 #define BUTTONMASK              (ButtonPressMask|ButtonReleaseMask)
 #define CLEANMASK(mask)         (mask & ~(numlockmask|LockMask) & (ShiftMask|ControlMask|Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|Mod5Mask))
 #define INTERSECT(x,y,w,h,m)    (MAX(0, MIN((x)+(w),(m)->wx+(m)->ww) - MAX((x),(m)->wx)) \
@@ -53,6 +62,7 @@
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
 #define TAGMASK                 ((1 << currentconfig->tagscount) - 1)
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define RULECACHESIZE           256 /* slots of rulecache, a power of two */
 
 #include "dat.h"
 #include "fns.h"
@@ -60,6 +70,7 @@
 /* variables */
 static const char broken[] = "broken";
 static char stext[256];
+static int stextw;           /* TEXTW(stext), see updatestatus() */
 static int screen;
 static int sw, sh;           /* X display screen geometry width, height */
 static int bh;               /* bar height */
@@ -84,48 +95,90 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 };
 static Atom wmatom[WMLast], netatom[NetLast];
 static int running = 1, repeat = 0;
+static int adopting = 0;     /* scan() manages windows in bulk */
+static int needflush = 0;    /* requests queued since the last flushrequests() */
+static unsigned long enterfirst = 1, enterlast = 0; /* serials of restack() requests */
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
+#ifdef XCB
+static xcb_connection_t *xcon;
+#endif /* XCB */
 static Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
 static const char *configpath;
+static char fallbackpath[256]; /* font fallbacks, see drw_fallback_save() */
+static Pool clientpool = { sizeof(Client), 64 };
+static WinEntry *wintab;     /* open addressing, indexed by winhash() */
+static unsigned int wintabsize, wintabused;
+static unsigned long narrange, nconfsent, nconfavoided; /* see commitgeom() */
+static unsigned long nframes, ncoalesced; /* bar render passes, see flushbatch() */
+static long long lastframe;  /* msnow() of the last render pass */
+static Monitor **monbynum;   /* indexed by Monitor.num, see updatemonnums() */
+static int nmonbynum;
+static RuleCache rulecache[RULECACHESIZE]; /* direct mapped by rulehash() */
+static unsigned long nrulehit, nrulemiss;
+static KeyEntry *keytab;     /* bindings of keycode k: keyidx[k] to keyidx[k + 1] */
+static unsigned int keyidx[257];
+static unsigned int keytabgen; /* bumped by each grabkeys() */
+static KeySym keysyms[256];  /* first keysym of each keycode */
+static int curmode;          /* index into currentconfig->modes */
+static const KeyNode *chord; /* keys that may continue the pending chord */
+static long long chordstart; /* msnow() when the last key of chord was typed */
+static Grab *grabs;          /* passive grabs on root, sorted by grabcmp() */
+static unsigned int ngrabs, grablockmask; /* grablockmask: numlockmask of grabs */
 
 /* function implementations */
 void
-applyrules(Client *c)
+applyrules(Client *c, const char *class, const char *instance)
 {
-	const char *class, *instance;
-	unsigned int i;
+	int i, mon = -1;
+	const char *subj[RuleFields];
+	const unsigned long *set;
+	RuleSet *rs = currentconfig->ruleset;
 	const Rule *r;
-	Monitor *m;
-	XClassHint ch = { NULL, NULL };
+	RuleCache *rc;
 
 	/* rule matching */
 	c->isfloating = 0;
 	c->tags = 0;
-	XGetClassHint(dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : broken;
-	instance = ch.res_name  ? ch.res_name  : broken;
-
-	for (i = 0; i < currentconfig->rulescount; i++) {
-		r = &currentconfig->rules[i];
-		if ((!r->title || strstr(c->name, r->title))
-		&& (!r->class || strstr(class, r->class))
-		&& (!r->instance || strstr(instance, r->instance)))
-		{
+	subj[RuleClass]    = class    ? class    : broken;
+	subj[RuleInstance] = instance ? instance : broken;
+	subj[RuleTitle]    = c->name;
+
+	rc = &rulecache[rulehash(subj[RuleClass], subj[RuleInstance]) & (RULECACHESIZE - 1)];
+	if (rc->class && !strcmp(rc->class, subj[RuleClass])
+	&& !strcmp(rc->instance, subj[RuleInstance]))
+	{
+		nrulehit++;
+		c->isfloating = rc->isfloating;
+		c->tags = rc->tags;
+		mon = rc->mon;
+	} else if (rs) {
+		nrulemiss++;
+		set = rules_match(rs, subj);
+		for (i = rules_next(rs, set, 0); i >= 0; i = rules_next(rs, set, i + 1)) {
+			r = &currentconfig->rules[i];
 			c->isfloating = r->isfloating;
 			c->tags |= r->tags;
-			for (m = mons; m && m->num != r->monitor; m = m->next);
-			if (m)
-				c->mon = m;
+			if (r->monitor >= 0 && r->monitor < nmonbynum && monbynum[r->monitor])
+				mon = r->monitor;
+		}
+		if (!rules_needtitle(rs)) {
+			free(rc->class);
+			free(rc->instance);
+			rc->class = strdup(subj[RuleClass]);
+			rc->instance = strdup(subj[RuleInstance]);
+			if (!rc->class || !rc->instance)
+				die("strdup:");
+			rc->tags = c->tags;
+			rc->isfloating = c->isfloating;
+			rc->mon = mon;
 		}
 	}
-	if (ch.res_class)
-		XFree(ch.res_class);
-	if (ch.res_name)
-		XFree(ch.res_name);
+	if (mon >= 0)
+		c->mon = monbynum[mon];
 	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
 }
 
@@ -164,6 +217,8 @@ applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 	if (currentconfig->lsettings.resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange) {
 		if (!c->hintsvalid)
 			updatesizehints(c);
+		if (!c->hashints) /* nothing below would change the size */
+			return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 		/* see last two sentences in ICCCM 4.1.2.3 */
 		baseismin = c->basew == c->minw && c->baseh == c->minh;
 		if (!baseismin) { /* temporarily remove base dimensions */
@@ -201,42 +256,84 @@ void
 arrange(Monitor *m)
 {
 	if (m)
-		showhide(m->stack);
+		showhide(m);
 	else for (m = mons; m; m = m->next)
-		showhide(m->stack);
+		showhide(m);
 	if (m) {
 		arrangemon(m);
 		restack(m);
 	} else for (m = mons; m; m = m->next)
 		arrangemon(m);
+	flushrequests();
 }
 
 void
 arrangemon(Monitor *m)
 {
 	strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
-	if (m->lt[m->sellt]->arrange)
+	if (m->lt[m->sellt]->arrange) {
+		m->ngeom = 0;
 		m->lt[m->sellt]->arrange(m);
+		commitgeom(m);
+	}
 }
 
 void
 attach(Client *c)
 {
+	c->prev = NULL;
 	c->next = c->mon->clients;
+	if (c->next)
+		c->next->prev = c;
 	c->mon->clients = c;
+	counttags(c, 1);
+	if (ISVISIBLE(c)) { /* c heads the list, so it heads the view too */
+		c->vprev = NULL;
+		c->vnext = c->mon->vis;
+		if (c->vnext)
+			c->vnext->vprev = c;
+		c->mon->vis = c;
+	}
 }
 
 void
 attachstack(Client *c)
 {
+	c->sprev = NULL;
 	c->snext = c->mon->stack;
+	if (c->snext)
+		c->snext->sprev = c;
 	c->mon->stack = c;
+	if (ISVISIBLE(c)) {
+		c->vsprev = NULL;
+		c->vsnext = c->mon->vstack;
+		if (c->vsnext)
+			c->vsnext->vsprev = c;
+		c->mon->vstack = c;
+	}
+}
+
+/* records what cell shows, returns whether that differs from the pixmap */
+int
+barcell(BarCell *cell, int full, int x, int w, int scm, unsigned int flags, const char *text)
+{
+	if (!full && cell->x == x && cell->w == w && cell->scheme == scm
+	&& cell->flags == flags && !strcmp(cell->text, text))
+		return 0;
+	cell->x = x;
+	cell->w = w;
+	cell->scheme = scm;
+	cell->flags = flags;
+	cell->dirty = 1;
+	strncpy(cell->text, text, sizeof cell->text - 1);
+	cell->text[sizeof cell->text - 1] = '\0';
+	return 1;
 }
 
 void
 buttonpress(XEvent *e)
 {
-	unsigned int i, x, click;
+	unsigned int i, click, lo, hi, mid;
 	Arg arg = {0};
 	Client *c;
 	Monitor *m;
@@ -250,19 +347,20 @@ buttonpress(XEvent *e)
 		focus(NULL);
 	}
 	if (ev->window == selmon->barwin) {
-		i = x = 0;
-		do
-			x += TEXTW(currentconfig->tags[i]);
-		while (ev->x >= x && ++i < currentconfig->tagscount);
-		if (i < currentconfig->tagscount) {
-			click = ClkTagBar;
-			arg.ui = 1 << i;
-		} else if (ev->x < x + TEXTW(selmon->ltsymbol))
-			click = ClkLtSymbol;
-		else if (ev->x > selmon->ww - (int)TEXTW(stext))
-			click = ClkStatusText;
-		else
-			click = ClkWinTitle;
+		/* last segment starting at or before ev->x, as drawn by drawbar() */
+		for (lo = 0, hi = selmon->nsegs; lo < hi; ) {
+			mid = lo + (hi - lo) / 2;
+			if (selmon->segs[mid].x <= ev->x)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		click = ClkWinTitle;
+		if (lo > 0) {
+			click = selmon->segs[lo - 1].click;
+			if (click == ClkTagBar)
+				arg.ui = 1 << selmon->segs[lo - 1].tag;
+		}
 	} else if ((c = wintoclient(ev->window))) {
 		focus(c);
 		restack(selmon);
@@ -286,6 +384,14 @@ checkotherwm(void)
 	XSync(dpy, False);
 }
 
+/* true if the pending chord ran out of time */
+int
+chordexpired(void)
+{
+	return chord && currentconfig->lsettings.chordtimeout > 0
+	    && msnow() - chordstart >= currentconfig->lsettings.chordtimeout;
+}
+
 void
 cleanup(void)
 {
@@ -299,6 +405,7 @@ cleanup(void)
 	for (m = mons; m; m = m->next)
 		while (m->stack)
 			unmanage(m->stack, 0);
+	endchord();
 	XUngrabKey(dpy, AnyKey, AnyModifier, root);
 	while (mons)
 		cleanupmon(mons);
@@ -308,7 +415,14 @@ cleanup(void)
 		free(scheme[i]);
 	free(scheme);
 	XDestroyWindow(dpy, wmcheckwin);
+	drw_fallback_save(drw, fallbackpath);
 	drw_free(drw);
+	free(wintab);
+	free(monbynum);
+	free(keytab);
+	free(grabs);
+	flushrulecache();
+	pooldestroy(&clientpool);
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
 	XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
@@ -325,8 +439,16 @@ cleanupmon(Monitor *mon)
 		for (m = mons; m && m->next != mon; m = m->next);
 		m->next = mon->next;
 	}
+	wintabdel(mon->barwin);
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
+	if (mon->barpix) {
+		drw_deldrawable(drw, mon->barpix);
+		XFreePixmap(dpy, mon->barpix);
+	}
+	free(mon->geom);
+	free(mon->segs);
+	free(mon->cells);
 	free(mon);
 }
 
@@ -349,6 +471,89 @@ clientmessage(XEvent *e)
 	}
 }
 
+/* merge redundant events of a batch into their last occurrence; merged
+ * events get type 0 so that run() skips them */
+void
+coalesce(XEvent *ev, int n)
+{
+	int i, j;
+	Window w;
+	XConfigureRequestEvent *a, *b;
+
+	for (i = 1; i < n; i++) {
+		if (ev[i].type != PropertyNotify && ev[i].type != ConfigureRequest)
+			continue;
+		w = getevwin(&ev[i]);
+		/* only look back to the previous event of the same window, so
+		 * that nothing is reordered across e.g. a MapRequest */
+		for (j = i - 1; j >= 0 && (!ev[j].type || getevwin(&ev[j]) != w); j--);
+		if (j < 0 || ev[j].type != ev[i].type)
+			continue;
+		if (ev[i].type == PropertyNotify) {
+			if (ev[j].xproperty.atom != ev[i].xproperty.atom)
+				continue;
+			if (ev[j].xproperty.state == PropertyNewValue)
+				ev[i].xproperty.state = PropertyNewValue;
+		} else {
+			/* keep earlier values the later request does not override */
+			a = &ev[j].xconfigurerequest;
+			b = &ev[i].xconfigurerequest;
+			if ((a->value_mask & CWX) && !(b->value_mask & CWX))
+				b->x = a->x;
+			if ((a->value_mask & CWY) && !(b->value_mask & CWY))
+				b->y = a->y;
+			if ((a->value_mask & CWWidth) && !(b->value_mask & CWWidth))
+				b->width = a->width;
+			if ((a->value_mask & CWHeight) && !(b->value_mask & CWHeight))
+				b->height = a->height;
+			if ((a->value_mask & CWBorderWidth) && !(b->value_mask & CWBorderWidth))
+				b->border_width = a->border_width;
+			if ((a->value_mask & CWSibling) && !(b->value_mask & CWSibling))
+				b->above = a->above;
+			if ((a->value_mask & CWStackMode) && !(b->value_mask & CWStackMode))
+				b->detail = a->detail;
+			b->value_mask |= a->value_mask;
+		}
+		ev[j].type = 0;
+	}
+}
+
+/* configure the clients whose target geometry differs from their current one */
+void
+commitgeom(Monitor *m)
+{
+	unsigned int i;
+	Geom *g;
+
+	narrange++;
+	for (i = 0; i < m->ngeom; i++) {
+		g = &m->geom[i];
+		if (g->x != g->c->x || g->y != g->c->y || g->w != g->c->w || g->h != g->c->h) {
+			resizeclient(g->c, g->x, g->y, g->w, g->h);
+			nconfsent++;
+		} else
+			nconfavoided++;
+	}
+}
+
+/* add (dir 1) or remove (dir -1) c in the tag counts of its monitor */
+void
+counttags(Client *c, int dir)
+{
+	Monitor *m = c->mon;
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(m->ntagged); i++) {
+		if (!(c->tags & 1u << i))
+			continue;
+		m->ntagged[i] += dir;
+		if (c->isurgent)
+			m->nurgent[i] += dir;
+		m->occ = m->ntagged[i] ? m->occ | 1u << i : m->occ & ~(1u << i);
+		m->urg = m->nurgent[i] ? m->urg | 1u << i : m->urg & ~(1u << i);
+	}
+}
+
 void
 configure(Client *c)
 {
@@ -382,7 +587,6 @@ configurenotify(XEvent *e)
 		sw = ev->width;
 		sh = ev->height;
 		if (updategeom() || dirty) {
-			drw_resize(drw, sw, bh);
 			updatebars();
 			for (m = mons; m; m = m->next) {
 				for (c = m->clients; c; c = c->next)
@@ -445,7 +649,26 @@ configurerequest(XEvent *e)
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
 	}
-	XSync(dpy, False);
+	needflush = 1;
+}
+
+int
+copytextprop(XTextProperty *name, char *text, unsigned int size)
+{
+	char **list = NULL;
+	int n;
+
+	text[0] = '\0';
+	if (!name->nitems)
+		return 0;
+	if (name->encoding == XA_STRING) {
+		strncpy(text, (char *)name->value, size - 1);
+	} else if (XmbTextPropertyToTextList(dpy, name, &list, &n) >= Success && n > 0 && *list) {
+		strncpy(text, *list, size - 1);
+		XFreeStringList(list);
+	}
+	text[size - 1] = '\0';
+	return 1;
 }
 
 Monitor *
@@ -465,6 +688,19 @@ createmon(void)
 	return m;
 }
 
+/* queue work on m, or on all monitors if m is NULL, for flushbatch() */
+void
+defer(Monitor *m, unsigned int what)
+{
+	Monitor *end = m ? m->next : NULL;
+
+	for (m = m ? m : mons; m != end; m = m->next) {
+		if (m->pending & what & PendingDraw)
+			ncoalesced++;
+		m->pending |= what;
+	}
+}
+
 void
 destroynotify(XEvent *e)
 {
@@ -478,24 +714,59 @@ destroynotify(XEvent *e)
 void
 detach(Client *c)
 {
-	Client **tc;
-
-	for (tc = &c->mon->clients; *tc && *tc != c; tc = &(*tc)->next);
-	*tc = c->next;
+	if (c->prev)
+		c->prev->next = c->next;
+	else
+		c->mon->clients = c->next;
+	if (c->next)
+		c->next->prev = c->prev;
+	c->next = c->prev = NULL;
+	counttags(c, -1);
+	detachview(c);
 }
 
 void
 detachstack(Client *c)
 {
-	Client **tc, *t;
+	if (c->sprev)
+		c->sprev->snext = c->snext;
+	else
+		c->mon->stack = c->snext;
+	if (c->snext)
+		c->snext->sprev = c->sprev;
+	c->snext = c->sprev = NULL;
+	detachvstack(c);
 
-	for (tc = &c->mon->stack; *tc && *tc != c; tc = &(*tc)->snext);
-	*tc = c->snext;
+	if (c == c->mon->sel)
+		c->mon->sel = c->mon->vstack;
+}
 
-	if (c == c->mon->sel) {
-		for (t = c->mon->stack; t && !ISVISIBLE(t); t = t->snext);
-		c->mon->sel = t;
-	}
+void
+detachview(Client *c)
+{
+	if (c->vprev)
+		c->vprev->vnext = c->vnext;
+	else if (c->mon->vis == c)
+		c->mon->vis = c->vnext;
+	else
+		return; /* not in view */
+	if (c->vnext)
+		c->vnext->vprev = c->vprev;
+	c->vnext = c->vprev = NULL;
+}
+
+void
+detachvstack(Client *c)
+{
+	if (c->vsprev)
+		c->vsprev->vsnext = c->vsnext;
+	else if (c->mon->vstack == c)
+		c->mon->vstack = c->vsnext;
+	else
+		return;
+	if (c->vsnext)
+		c->vsnext->vsprev = c->vsprev;
+	c->vsnext = c->vsprev = NULL;
 }
 
 Monitor *
@@ -516,63 +787,127 @@ dirtomon(int dir)
 void
 drawbar(Monitor *m)
 {
-	int x, w, tw = 0;
+	int x, w, tw = 0, full, dx, dw;
 	int boxs = drw->fonts->h / 9;
 	int boxw = drw->fonts->h / 6 + 2;
-	unsigned int i, occ = 0, urg = 0;
-	Client *c;
+	unsigned int i, n = currentconfig->tagscount, occ = m->occ, urg = m->urg, flags;
+	BarCell *cell;
+	int scm;
 
 	if (!m->showbar)
 		return;
 
+	drw_setdrawable(drw, m->barpix);
+	full = !m->barvalid;
+	m->barvalid = 1;
+
+	/* tags, layout symbol, title and status, for buttonpress() */
+	if (m->segssize < n + 3) {
+		m->segssize = n + 3;
+		if (!(m->segs = realloc(m->segs, m->segssize * sizeof(BarSeg)))
+		|| !(m->cells = realloc(m->cells, m->segssize * sizeof(BarCell))))
+			die("realloc:");
+		full = 1;
+	}
+	m->nsegs = 0;
+
 	/* draw status first so it can be overdrawn by tags later */
-	if (m == selmon) { /* status is only drawn on selected monitor */
+	if (m == selmon) /* status is only drawn on selected monitor */
+		tw = stextw - lrpad + 2; /* 2px right padding */
+	if (barcell(&m->cells[n + 2], full, m->ww - tw, tw, SchemeNorm, 0, tw ? stext : "")
+	&& tw) {
 		drw_setscheme(drw, scheme[SchemeNorm]);
-		tw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
 		drw_text(drw, m->ww - tw, 0, tw, bh, 0, stext, 0);
 	}
 
-	for (c = m->clients; c; c = c->next) {
-		occ |= c->tags;
-		if (c->isurgent)
-			urg |= c->tags;
-	}
 	x = 0;
-	for (i = 0; i < currentconfig->tagscount; i++) {
+	for (i = 0; i < n; i++) {
 		w = TEXTW(currentconfig->tags[i]);
-		drw_setscheme(drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-		drw_text(drw, x, 0, w, bh, lrpad / 2, currentconfig->tags[i], urg & 1 << i);
-		if (occ & 1 << i)
-			drw_rect(drw, x + boxs, boxs, boxw, boxw,
-				m == selmon && selmon->sel && selmon->sel->tags & 1 << i,
-				urg & 1 << i);
+		m->segs[m->nsegs++] = (BarSeg){ x, ClkTagBar, i };
+		scm = m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm;
+		flags = (urg & 1 << i ? CellInvert : 0) | (occ & 1 << i ? CellBox : 0)
+		      | (m == selmon && selmon->sel && selmon->sel->tags & 1 << i ? CellBoxFilled : 0);
+		/* where the status was drawn over the tag, it has to be restored */
+		if (barcell(&m->cells[i], full || (m->cells[n + 2].dirty && x + w > m->ww - tw),
+		            x, w, scm, flags, currentconfig->tags[i])) {
+			drw_setscheme(drw, scheme[scm]);
+			drw_text(drw, x, 0, w, bh, lrpad / 2, currentconfig->tags[i], urg & 1 << i);
+			if (occ & 1 << i)
+				drw_rect(drw, x + boxs, boxs, boxw, boxw, flags & CellBoxFilled, urg & 1 << i);
+		}
 		x += w;
 	}
 	w = TEXTW(m->ltsymbol);
-	drw_setscheme(drw, scheme[SchemeNorm]);
-	x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
-
-	if ((w = m->ww - tw - x) > bh) {
-		if (m->sel) {
-			drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
+	m->segs[m->nsegs++] = (BarSeg){ x, ClkLtSymbol, 0 };
+	if (barcell(&m->cells[n], full || (m->cells[n + 2].dirty && x + w > m->ww - tw),
+	            x, w, SchemeNorm, 0, m->ltsymbol)) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+	}
+	x += w;
+	m->segs[m->nsegs++] = (BarSeg){ x, ClkWinTitle, 0 };
+	/* clicks on the status area count even where it is not drawn */
+	m->segs[m->nsegs++] = (BarSeg){ MAX(x, m->ww - stextw + 1), ClkStatusText, 0 };
+
+	if ((w = m->ww - tw - x) <= bh)
+		barcell(&m->cells[n + 1], full, x, 0, SchemeNorm, CellEmpty, "");
+	else if (m->sel) {
+		scm = m == selmon ? SchemeSel : SchemeNorm;
+		flags = (m->sel->isfloating ? CellBox : 0) | (m->sel->isfixed ? CellBoxFilled : 0);
+		if (barcell(&m->cells[n + 1], full, x, w, scm, flags, m->sel->name)) {
+			drw_setscheme(drw, scheme[scm]);
 			drw_text(drw, x, 0, w, bh, lrpad / 2, m->sel->name, 0);
 			if (m->sel->isfloating)
 				drw_rect(drw, x + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
-		} else {
-			drw_setscheme(drw, scheme[SchemeNorm]);
-			drw_rect(drw, x, 0, w, bh, 1, 1);
 		}
+	} else if (barcell(&m->cells[n + 1], full, x, w, SchemeNorm, CellEmpty, "")) {
+		drw_setscheme(drw, scheme[SchemeNorm]);
+		drw_rect(drw, x, 0, w, bh, 1, 1);
+	}
+
+	/* copy the damaged spans, adjacent cells in one go */
+	if (full)
+		drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+	for (i = dx = dw = 0; i < n + 3; i++) {
+		cell = &m->cells[i];
+		if (!cell->dirty)
+			continue;
+		cell->dirty = 0;
+		if (full || !cell->w)
+			continue;
+		if (dw && cell->x == dx + dw) {
+			dw += cell->w;
+			continue;
+		}
+		if (dw)
+			drw_map(drw, m->barwin, dx, 0, dw, bh);
+		dx = cell->x;
+		dw = cell->w;
 	}
-	drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+	if (dw)
+		drw_map(drw, m->barwin, dx, 0, dw, bh);
+	needflush = 1;
 }
 
 void
-drawbars(void)
+dumpstats(const Arg *arg)
 {
-	Monitor *m;
+	fprintf(stderr, "dwm: clients: %u live, %u peak, %u chunks of %zu\n",
+		clientpool.live, clientpool.peak, clientpool.nchunks, clientpool.perchunk);
+	fprintf(stderr, "dwm: rule cache: %lu hits, %lu misses\n", nrulehit, nrulemiss);
+	fprintf(stderr, "dwm: arrange: %lu runs, %lu configures sent, %lu avoided (%.1f per run)\n",
+		narrange, nconfsent, nconfavoided, narrange ? (double)nconfavoided / narrange : 0.0);
+	fprintf(stderr, "dwm: bar: %lu render passes, %lu redraws coalesced\n", nframes, ncoalesced);
+}
 
-	for (m = mons; m; m = m->next)
-		drawbar(m);
+/* drop the pending chord, if any */
+void
+endchord(void)
+{
+	if (!chord)
+		return;
+	chord = NULL;
+	XUngrabKeyboard(dpy, CurrentTime);
 }
 
 void
@@ -582,6 +917,10 @@ enternotify(XEvent *e)
 	Monitor *m;
 	XCrossingEvent *ev = &e->xcrossing;
 
+	if (ev->serial >= enterfirst && ev->serial <= enterlast) /* caused by restack() */
+		return;
+	if (ev->serial > enterlast) /* the ones of restack() are all past */
+		enterfirst = enterlast + 1;
 	if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) && ev->window != root)
 		return;
 	c = wintoclient(ev->window);
@@ -600,15 +939,224 @@ expose(XEvent *e)
 	Monitor *m;
 	XExposeEvent *ev = &e->xexpose;
 
-	if (ev->count == 0 && (m = wintomon(ev->window)))
-		drawbar(m);
+	if (ev->count == 0 && (m = wintomon(ev->window))) {
+		if (!m->barvalid) {
+			defer(m, PendingDraw);
+		} else if (m->showbar) {
+			drw_setdrawable(drw, m->barpix);
+			drw_map(drw, m->barwin, 0, 0, m->ww, bh);
+			needflush = 1;
+		}
+	}
+}
+
+#ifdef XCB
+static void *
+propvalue(xcb_get_property_reply_t *r, xcb_atom_t type, int format, unsigned int min)
+{
+	if (!r || r->type != type || r->format != format || r->value_len < min)
+		return NULL;
+	return xcb_get_property_value(r);
+}
+
+static void
+xcbtextprop(xcb_get_property_reply_t *r, char *text, unsigned int size)
+{
+	XTextProperty name;
+	char *v;
+
+	text[0] = '\0';
+	if (!r || r->format != 8 || !r->value_len)
+		return;
+	/* property data is not NUL-terminated like XGetTextProperty's */
+	v = ecalloc(r->value_len + 1, 1);
+	memcpy(v, xcb_get_property_value(r), r->value_len);
+	name.value = (unsigned char *)v;
+	name.encoding = r->type;
+	name.format = r->format;
+	name.nitems = r->value_len;
+	copytextprop(&name, text, size);
+	free(v);
+}
+
+/* issue every request up front and collect the replies afterwards, so that
+ * all of them cost a single round trip */
+void
+fetchprops(Window w, Props *p)
+{
+	enum { PropNetName, PropName, PropTrans, PropClass, PropState, PropType, PropSize, PropHints, PropLast };
+	struct {
+		xcb_atom_t prop, type;
+		uint32_t len;
+	} req[PropLast] = {
+		[PropNetName] = { netatom[NetWMName],       XCB_GET_PROPERTY_TYPE_ANY, sizeof p->name / 4 },
+		[PropName]    = { XA_WM_NAME,               XCB_GET_PROPERTY_TYPE_ANY, sizeof p->name / 4 },
+		[PropTrans]   = { XA_WM_TRANSIENT_FOR,      XA_WINDOW,                 1 },
+		[PropClass]   = { XA_WM_CLASS,              XA_STRING,                 (sizeof p->class + sizeof p->instance) / 4 },
+		[PropState]   = { netatom[NetWMState],      XA_ATOM,                   1 },
+		[PropType]    = { netatom[NetWMWindowType], XA_ATOM,                   1 },
+		[PropSize]    = { XA_WM_NORMAL_HINTS,       XA_WM_SIZE_HINTS,          18 },
+		[PropHints]   = { XA_WM_HINTS,              XA_WM_HINTS,               9 },
+	};
+	xcb_get_property_cookie_t ck[PropLast];
+	xcb_get_property_reply_t *r[PropLast];
+	uint32_t *v;
+	char *s, *e;
+	int i;
+
+	for (i = 0; i < PropLast; i++)
+		ck[i] = xcb_get_property(xcon, 0, w, req[i].prop, req[i].type, 0, req[i].len);
+	for (i = 0; i < PropLast; i++)
+		r[i] = xcb_get_property_reply(xcon, ck[i], NULL);
+
+	memset(p, 0, sizeof(*p));
+	xcbtextprop(r[PropNetName], p->name, sizeof p->name);
+	if (!p->name[0])
+		xcbtextprop(r[PropName], p->name, sizeof p->name);
+	if ((v = propvalue(r[PropTrans], XA_WINDOW, 32, 1)))
+		p->trans = v[0];
+	if ((s = propvalue(r[PropClass], XA_STRING, 8, 1))) {
+		/* "instance\0class\0" as in XGetClassHint */
+		e = s + r[PropClass]->value_len;
+		p->hasclass = 1;
+		snprintf(p->instance, sizeof p->instance, "%.*s", (int)strnlen(s, e - s), s);
+		s += strnlen(s, e - s) + 1;
+		if (s < e)
+			snprintf(p->class, sizeof p->class, "%.*s", (int)strnlen(s, e - s), s);
+	}
+	if ((v = propvalue(r[PropState], XA_ATOM, 32, 1)))
+		p->state = v[0];
+	if ((v = propvalue(r[PropType], XA_ATOM, 32, 1)))
+		p->wtype = v[0];
+	p->size.flags = PSize;
+	if ((v = propvalue(r[PropSize], XA_WM_SIZE_HINTS, 32, 15))) {
+		/* see XGetWMNormalHints: the last three fields are optional */
+		p->size.flags = v[0] & (USPosition|USSize|PAllHints);
+		p->size.min_width = v[5];
+		p->size.min_height = v[6];
+		p->size.max_width = v[7];
+		p->size.max_height = v[8];
+		p->size.width_inc = v[9];
+		p->size.height_inc = v[10];
+		p->size.min_aspect.x = v[11];
+		p->size.min_aspect.y = v[12];
+		p->size.max_aspect.x = v[13];
+		p->size.max_aspect.y = v[14];
+		if (r[PropSize]->value_len >= 18) {
+			p->size.flags |= v[0] & (PBaseSize|PWinGravity);
+			p->size.base_width = v[15];
+			p->size.base_height = v[16];
+			p->size.win_gravity = v[17];
+		}
+	}
+	if ((v = propvalue(r[PropHints], XA_WM_HINTS, 32, 8))) {
+		p->haswmh = 1;
+		p->wmh.flags = v[0];
+		p->wmh.input = v[1];
+		p->wmh.initial_state = v[2];
+		p->wmh.icon_pixmap = v[3];
+		p->wmh.icon_window = v[4];
+		p->wmh.icon_x = v[5];
+		p->wmh.icon_y = v[6];
+		p->wmh.icon_mask = v[7];
+		p->wmh.window_group = r[PropHints]->value_len >= 9 ? v[8] : 0;
+	}
+	for (i = 0; i < PropLast; i++)
+		free(r[i]);
+}
+#else
+void
+fetchprops(Window w, Props *p)
+{
+	long msize;
+	XWMHints *wmh;
+	XClassHint ch = { NULL, NULL };
+
+	memset(p, 0, sizeof(*p));
+	if (!gettextprop(w, netatom[NetWMName], p->name, sizeof p->name))
+		gettextprop(w, XA_WM_NAME, p->name, sizeof p->name);
+	if (!XGetTransientForHint(dpy, w, &p->trans))
+		p->trans = None;
+	if (XGetClassHint(dpy, w, &ch)) {
+		p->hasclass = 1;
+		if (ch.res_name)
+			snprintf(p->instance, sizeof p->instance, "%s", ch.res_name);
+		if (ch.res_class)
+			snprintf(p->class, sizeof p->class, "%s", ch.res_class);
+	}
+	if (ch.res_class)
+		XFree(ch.res_class);
+	if (ch.res_name)
+		XFree(ch.res_name);
+	p->state = getwinatomprop(w, netatom[NetWMState]);
+	p->wtype = getwinatomprop(w, netatom[NetWMWindowType]);
+	if (!XGetWMNormalHints(dpy, w, &p->size, &msize))
+		/* size is uninitialized, ensure that size.flags aren't used */
+		p->size.flags = PSize;
+	if ((wmh = XGetWMHints(dpy, w))) {
+		p->haswmh = 1;
+		p->wmh = *wmh;
+		XFree(wmh);
+	}
+}
+#endif /* XCB */
+
+/* run the arranges deferred by the handlers of a batch, and the bar
+ * redraws once a frame at refreshrate is due, see waitevent() */
+void
+flushbatch(void)
+{
+	Monitor *m;
+	int draw = 0;
+
+	for (m = mons; m; m = m->next) {
+		if (m->pending & PendingArrange) {
+			m->pending &= ~PendingArrange;
+			arrange(m); /* defers the bar through restack() */
+		}
+		draw |= m->pending & PendingDraw;
+	}
+	if (draw && frameleft() == 0) {
+		for (m = mons; m; m = m->next)
+			if (m->pending & PendingDraw) {
+				m->pending &= ~PendingDraw;
+				drawbar(m);
+			}
+		lastframe = msnow();
+		nframes++;
+	}
+	flushrequests();
+}
+
+/* send everything queued since the last flush without waiting for the
+ * server; callers that need a reply or error still use XSync() */
+void
+flushrequests(void)
+{
+	if (needflush) {
+		XFlush(dpy);
+		needflush = 0;
+	}
+}
+
+/* drop the results cached by applyrules() */
+void
+flushrulecache(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < RULECACHESIZE; i++) {
+		free(rulecache[i].class);
+		free(rulecache[i].instance);
+		rulecache[i].class = rulecache[i].instance = NULL;
+	}
 }
 
 void
 focus(Client *c)
 {
 	if (!c || !ISVISIBLE(c))
-		for (c = selmon->stack; c && !ISVISIBLE(c); c = c->snext);
+		c = selmon->vstack;
 	if (selmon->sel && selmon->sel != c)
 		unfocus(selmon->sel, 0);
 	if (c) {
@@ -626,7 +1174,7 @@ focus(Client *c)
 		XDeleteProperty(dpy, root, netatom[NetActiveWindow]);
 	}
 	selmon->sel = c;
-	drawbars();
+	defer(NULL, PendingDraw);
 }
 
 /* there are some broken focus acquiring clients needing extra handling */
@@ -656,43 +1204,48 @@ focusmon(const Arg *arg)
 void
 focusstack(const Arg *arg)
 {
-	Client *c = NULL, *i;
+	Client *c;
 
 	if (!selmon->sel || (selmon->sel->isfullscreen && currentconfig->lsettings.lockfullscreen))
 		return;
 	if (arg->i > 0) {
-		for (c = selmon->sel->next; c && !ISVISIBLE(c); c = c->next);
-		if (!c)
-			for (c = selmon->clients; c && !ISVISIBLE(c); c = c->next);
-	} else {
-		for (i = selmon->clients; i != selmon->sel; i = i->next)
-			if (ISVISIBLE(i))
-				c = i;
-		if (!c)
-			for (; i; i = i->next)
-				if (ISVISIBLE(i))
-					c = i;
-	}
+		if (!(c = selmon->sel->vnext))
+			c = selmon->vis;
+	} else if (!(c = selmon->sel->vprev))
+		for (c = selmon->vis; c && c->vnext; c = c->vnext);
 	if (c) {
 		focus(c);
 		restack(selmon);
 	}
 }
 
+/* ms until the bars may be drawn again, at most refreshrate times a second */
+long long
+frameleft(void)
+{
+	if (currentconfig->lsettings.refreshrate <= 0)
+		return 0;
+	return MAX(0, lastframe + 1000 / currentconfig->lsettings.refreshrate - msnow());
+}
+
 Atom
 getatomprop(Client *c, Atom prop)
 {
-	int di;
-	unsigned long dl;
-	unsigned char *p = NULL;
-	Atom da, atom = None;
+	return getwinatomprop(c->win, prop);
+}
 
-	if (XGetWindowProperty(dpy, c->win, prop, 0L, sizeof atom, False, XA_ATOM,
-		&da, &di, &dl, &dl, &p) == Success && p) {
-		atom = *(Atom *)p;
-		XFree(p);
+/* the window an event is about, which is not always xany.window */
+Window
+getevwin(XEvent *e)
+{
+	switch (e->type) {
+	case ConfigureRequest: return e->xconfigurerequest.window;
+	case ConfigureNotify:  return e->xconfigure.window;
+	case DestroyNotify:    return e->xdestroywindow.window;
+	case MapRequest:       return e->xmaprequest.window;
+	case UnmapNotify:      return e->xunmap.window;
+	default:               return e->xany.window;
 	}
-	return atom;
 }
 
 int
@@ -723,33 +1276,44 @@ getstate(Window w)
 	return result;
 }
 
+Atom
+getwinatomprop(Window w, Atom prop)
+{
+	int di;
+	unsigned long dl;
+	unsigned char *p = NULL;
+	Atom da, atom = None;
+
+	if (XGetWindowProperty(dpy, w, prop, 0L, sizeof atom, False, XA_ATOM,
+		&da, &di, &dl, &dl, &p) == Success && p) {
+		atom = *(Atom *)p;
+		XFree(p);
+	}
+	return atom;
+}
+
 int
 gettextprop(Window w, Atom atom, char *text, unsigned int size)
 {
-	char **list = NULL;
-	int n;
+	int ret;
 	XTextProperty name;
 
 	if (!text || size == 0)
 		return 0;
 	text[0] = '\0';
-	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
+	if (!XGetTextProperty(dpy, w, &name, atom))
 		return 0;
-	if (name.encoding == XA_STRING) {
-		strncpy(text, (char *)name.value, size - 1);
-	} else if (XmbTextPropertyToTextList(dpy, &name, &list, &n) >= Success && n > 0 && *list) {
-		strncpy(text, *list, size - 1);
-		XFreeStringList(list);
-	}
-	text[size - 1] = '\0';
+	ret = copytextprop(&name, text, size);
 	XFree(name.value);
-	return 1;
+	return ret;
 }
 
 void
 grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
+	if (c->buttons == (focused ? ButtonsFocused : ButtonsUnfocused))
+		return;
+	c->buttons = focused ? ButtonsFocused : ButtonsUnfocused;
 	{
 		unsigned int i, j;
 		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
@@ -767,34 +1331,130 @@ grabbuttons(Client *c, int focused)
 	}
 }
 
+int
+grabcmp(const void *a, const void *b)
+{
+	const Grab *ga = a, *gb = b;
+
+	if (ga->code != gb->code)
+		return ga->code < gb->code ? -1 : 1;
+	return ga->mod < gb->mod ? -1 : ga->mod > gb->mod;
+}
+
+/* grab (or ungrab) g->code with g->mod under every lock combination */
+void
+grabkey(const Grab *g, int grab)
+{
+	unsigned int j;
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+
+	for (j = 0; j < LENGTH(modifiers); j++)
+		if (grab)
+			XGrabKey(dpy, g->code, g->mod | modifiers[j], root, True,
+				GrabModeAsync, GrabModeAsync);
+		else
+			XUngrabKey(dpy, g->code, g->mod | modifiers[j], root);
+}
+
 void
 grabkeys(void)
 {
-	updatenumlockmask();
 	{
-		unsigned int i, j, k;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-		int start, end, skip;
+		unsigned int i, j, k, n, ng, fill[256];
+		int start, end, skip, d;
+		const KeyNode *top = currentconfig->keytries[curmode], *key;
 		KeySym *syms;
-
-		XUngrabKey(dpy, AnyKey, AnyModifier, root);
+		KeyMap *map;
+		Grab *g;
+
+		endchord(); /* its nodes may be about to go away */
+		keytabgen++;
+		free(keytab);
+		keytab = NULL;
+		memset(keyidx, 0, sizeof keyidx);
+		memset(keysyms, 0, sizeof keysyms);
 		XDisplayKeycodes(dpy, &start, &end);
 		syms = XGetKeyboardMapping(dpy, start, end - start + 1, &skip);
-		if (!syms)
+		if (!syms) {
+			XUngrabKey(dpy, AnyKey, AnyModifier, root);
+			ngrabs = 0;
 			return;
-		for (k = start; k <= end; k++)
-			for (i = 0; i < currentconfig->keyscount; i++)
-				/* skip modifier codes, we do that ourselves */
-				if (currentconfig->keys[i].keysym == syms[(k - start) * skip])
-					for (j = 0; j < LENGTH(modifiers); j++)
-						XGrabKey(dpy, k,
-							 currentconfig->keys[i].mod | modifiers[j],
-							 root, True,
-							 GrabModeAsync, GrabModeAsync);
+		}
+		/* keysym -> keycodes; skip modifier codes, we do that ourselves */
+		n = end - start + 1;
+		map = ecalloc(n, sizeof(KeyMap));
+		for (k = 0; k < n; k++) {
+			map[k].sym = keysyms[start + k] = syms[k * skip];
+			map[k].code = start + k;
+		}
 		XFree(syms);
+		qsort(map, n, sizeof(KeyMap), keymapcmp);
+
+		/* count the first keys of the mode on each keycode, then lay them
+		 * out in keycode order so that keypress() only looks at its own */
+		for (key = top; key; key = key->next)
+			for (k = keymapfind(map, n, key->keysym); k < n && map[k].sym == key->keysym; k++)
+				keyidx[map[k].code + 1]++;
+		for (k = 1; k < LENGTH(keyidx); k++)
+			keyidx[k] += keyidx[k - 1];
+		memcpy(fill, keyidx, sizeof fill);
+		ng = keyidx[LENGTH(keyidx) - 1];
+		keytab = ecalloc(MAX(ng, 1), sizeof(KeyEntry));
+		g = ecalloc(MAX(ng, 1), sizeof(Grab));
+		for (ng = 0, key = top; key; key = key->next) {
+			for (k = keymapfind(map, n, key->keysym); k < n && map[k].sym == key->keysym; k++) {
+				keytab[fill[map[k].code]].mod = CLEANMASK(key->mod);
+				keytab[fill[map[k].code]++].node = key;
+				g[ng].code = map[k].code;
+				g[ng++].mod = key->mod;
+			}
+		}
+		free(map);
+		qsort(g, ng, sizeof(Grab), grabcmp);
+		for (i = j = 0; i < ng; i++) /* drop duplicates */
+			if (!j || grabcmp(&g[j - 1], &g[i]))
+				g[j++] = g[i];
+		ng = j;
+
+		/* grabs for the old numlockmask can not be diffed against */
+		if (numlockmask != grablockmask) {
+			XUngrabKey(dpy, AnyKey, AnyModifier, root);
+			ngrabs = 0;
+		}
+		for (i = j = 0; i < ngrabs || j < ng; ) {
+			if (i == ngrabs)
+				d = 1;
+			else if (j == ng)
+				d = -1;
+			else
+				d = grabcmp(&grabs[i], &g[j]);
+			if (d < 0)
+				grabkey(&grabs[i++], 0);
+			else if (d > 0)
+				grabkey(&g[j++], 1);
+			else
+				i++, j++;
+		}
+		free(grabs);
+		grabs = g;
+		ngrabs = ng;
+		grablockmask = numlockmask;
 	}
 }
 
+/* move c off screen, or unmap it in iconify mode so that it can stop drawing */
+void
+hideclient(Client *c)
+{
+	if (currentconfig->lsettings.iconify && !c->iconic) {
+		c->ignoreunmap += 2; /* reported on c->win and on root */
+		XUnmapWindow(dpy, c->win);
+		seticonic(c, 1);
+	} else
+		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
+	c->shown = 0;
+}
+
 void
 incnmaster(const Arg *arg)
 {
@@ -814,20 +1474,82 @@ isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
 }
 #endif /* XINERAMA */
 
+int
+keymapcmp(const void *a, const void *b)
+{
+	const KeyMap *ka = a, *kb = b;
+
+	if (ka->sym != kb->sym)
+		return ka->sym < kb->sym ? -1 : 1;
+	return ka->code - kb->code;
+}
+
+/* index of the first entry of the sorted map with sym, or past it */
+unsigned int
+keymapfind(const KeyMap *map, unsigned int n, KeySym sym)
+{
+	unsigned int lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (map[mid].sym < sym)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 void
 keypress(XEvent *e)
 {
-	unsigned int i;
-	KeySym keysym;
+	unsigned int i, mod, gen = keytabgen;
+	const KeyNode *n, *level, *prefix = NULL;
+	const Key *k;
 	XKeyEvent *ev;
+	KeySym sym;
 
 	ev = &e->xkey;
-	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-	for (i = 0; i < currentconfig->keyscount; i++)
-		if (keysym == currentconfig->keys[i].keysym
-		&& CLEANMASK(currentconfig->keys[i].mod) == CLEANMASK(ev->state)
-		&& currentconfig->keys[i].func)
-			currentconfig->keys[i].func(&(currentconfig->keys[i].arg));
+	mod = CLEANMASK(ev->state);
+	if (!chord) {
+		/* a chord takes precedence over a binding on the same key */
+		for (i = keyidx[ev->keycode]; i < keyidx[ev->keycode + 1] && !prefix; i++)
+			if (keytab[i].mod == mod && !keytab[i].node->key)
+				prefix = keytab[i].node;
+		if (prefix) {
+			startchord(prefix->child);
+			return;
+		}
+		for (i = keyidx[ev->keycode]; i < keyidx[ev->keycode + 1]; i++) {
+			if (keytab[i].mod == mod && (k = keytab[i].node->key) && k->func) {
+				k->func(&k->arg);
+				if (gen != keytabgen) /* grabkeys() replaced the table */
+					return;
+			}
+		}
+		return;
+	}
+
+	/* next key of a chord, the keyboard is grabbed */
+	sym = keysyms[ev->keycode];
+	if (IsModifierKey(sym))
+		return;
+	level = chord;
+	for (n = level; n && !prefix; n = n->next)
+		if (n->keysym == sym && CLEANMASK(n->mod) == mod && !n->key)
+			prefix = n;
+	if (prefix) {
+		chord = prefix->child;
+		chordstart = msnow();
+		return;
+	}
+	endchord(); /* also on a key that is not bound */
+	for (n = level; n; n = n->next)
+		if (n->keysym == sym && CLEANMASK(n->mod) == mod && n->key->func) {
+			n->key->func(&n->key->arg);
+			if (gen != keytabgen)
+				return;
+		}
 }
 
 void
@@ -850,11 +1572,13 @@ void
 manage(Window w, XWindowAttributes *wa)
 {
 	Client *c, *t = NULL;
-	Window trans = None;
+	Window trans;
 	XWindowChanges wc;
+	Props p;
 
-	c = ecalloc(1, sizeof(Client));
+	c = poolalloc(&clientpool);
 	c->win = w;
+	wintabadd(w, c, NULL);
 	/* geometry */
 	c->x = c->oldx = wa->x;
 	c->y = c->oldy = wa->y;
@@ -862,13 +1586,14 @@ manage(Window w, XWindowAttributes *wa)
 	c->h = c->oldh = wa->height;
 	c->oldbw = wa->border_width;
 
-	updatetitle(c);
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	fetchprops(w, &p);
+	settitle(c, p.name);
+	if ((trans = p.trans) != None && (t = wintoclient(trans))) {
 		c->mon = t->mon;
 		c->tags = t->tags;
 	} else {
 		c->mon = selmon;
-		applyrules(c);
+		applyrules(c, p.hasclass ? p.class : NULL, p.hasclass ? p.instance : NULL);
 	}
 
 	if (c->x + WIDTH(c) > c->mon->wx + c->mon->ww)
@@ -883,9 +1608,9 @@ manage(Window w, XWindowAttributes *wa)
 	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
 	XSetWindowBorder(dpy, w, scheme[SchemeNorm][ColBorder].pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
+	setwindowtype(c, p.state, p.wtype);
+	setsizehints(c, &p.size);
+	setwmhints(c, p.haswmh ? &p.wmh : NULL);
 	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	grabbuttons(c, 0);
 	if (!c->isfloating)
@@ -898,21 +1623,42 @@ manage(Window w, XWindowAttributes *wa)
 		(unsigned char *) &(c->win), 1);
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
 	setclientstate(c, NormalState);
+	if (!ISVISIBLE(c) && currentconfig->lsettings.iconify) {
+		if (wa->map_state != IsUnmapped)
+			c->shown = 1; /* already mapped, let showhide() unmap it */
+		else
+			seticonic(c, 1);
+	}
 	if (c->mon == selmon)
 		unfocus(selmon->sel, 0);
 	c->mon->sel = c;
-	arrange(c->mon);
-	XMapWindow(dpy, c->win);
-	focus(NULL);
+	if (!adopting)
+		arrange(c->mon);
+	if (!c->iconic)
+		XMapWindow(dpy, c->win);
+	if (!adopting)
+		focus(NULL);
 }
 
 void
 mappingnotify(XEvent *e)
 {
 	XMappingEvent *ev = &e->xmapping;
+	unsigned int oldlock = numlockmask;
+	Client *c;
+	Monitor *m;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
+	if (ev->request != MappingKeyboard && ev->request != MappingModifier)
+		return;
+	updatenumlockmask();
+	if (numlockmask != oldlock) /* button grabs carry the old lock variants */
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next) {
+				c->buttons = ButtonsNone;
+				grabbuttons(c, c == selmon->sel);
+			}
+	if (ev->request == MappingKeyboard || numlockmask != oldlock)
 		grabkeys();
 }
 
@@ -934,14 +1680,13 @@ monocle(Monitor *m)
 	unsigned int n = 0;
 	Client *c;
 
-	for (c = m->clients; c; c = c->next)
-		if (ISVISIBLE(c))
-			n++;
+	for (c = m->vis; c; c = c->vnext)
+		n++;
 	if (n > 0) /* override layout symbol */
 		snprintf(m->ltsymbol, sizeof m->ltsymbol, "[%d]", n);
 
-	for (c = nexttiled(m->clients); c; c = nexttiled(c->next))
-		resize_arrange(c, m->wx + currentconfig->appearance.gappx, m->wy + currentconfig->appearance.gappx, m->ww - 2 * currentconfig->appearance.gappx, m->wh - 2 * currentconfig->appearance.gappx);
+	for (c = nexttiled(m->vis); c; c = nexttiled(c->vnext))
+		place(c, m->wx + currentconfig->appearance.gappx, m->wy + currentconfig->appearance.gappx, m->ww - 2 * currentconfig->appearance.gappx, m->wh - 2 * currentconfig->appearance.gappx);
 }
 
 void
@@ -1007,6 +1752,7 @@ movemouse(const Arg *arg)
 				togglefloating(NULL);
 			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
 				resize(c, nx, ny, c->w, c->h, 1);
+			flushbatch(); /* bar of a togglefloating() above, once due */
 			break;
 		case KeyPress:
 			break;
@@ -1016,6 +1762,7 @@ movemouse(const Arg *arg)
 		default:
 			if(handler[ev.type])
 				handler[ev.type](&ev);
+			flushbatch();
 		}
 	} while (grabbing);
 	XUngrabPointer(dpy, CurrentTime);
@@ -1026,13 +1773,45 @@ movemouse(const Arg *arg)
 	}
 }
 
+/* CLOCK_MONOTONIC in milliseconds */
+long long
+msnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* c is a member of the view list of its monitor */
 Client *
 nexttiled(Client *c)
 {
-	for (; c && (c->isfloating || !ISVISIBLE(c)); c = c->next);
+	for (; c && c->isfloating; c = c->vnext);
 	return c;
 }
 
+/* record where the layout wants c, sized to its hints; commitgeom() applies it */
+const Geom *
+place(Client *c, int x, int y, int w, int h)
+{
+	Monitor *m = c->mon;
+	Geom *g;
+
+	w -= 2 * c->bw;
+	h -= 2 * c->bw;
+	applysizehints(c, &x, &y, &w, &h, 0);
+	if (m->ngeom == m->geomsize) {
+		m->geomsize = m->geomsize ? m->geomsize * 2 : 16;
+		if (!(m->geom = realloc(m->geom, m->geomsize * sizeof(Geom))))
+			die("realloc:");
+	}
+	g = &m->geom[m->ngeom++];
+	g->c = c;
+	g->x = x; g->y = y; g->w = w; g->h = h;
+	return g;
+}
+
 void
 pop(Client *c)
 {
@@ -1059,20 +1838,20 @@ propertynotify(XEvent *e)
 		case XA_WM_TRANSIENT_FOR:
 			if (!c->isfloating && (XGetTransientForHint(dpy, c->win, &trans)) &&
 				(c->isfloating = (wintoclient(trans)) != NULL))
-				arrange(c->mon);
+				defer(c->mon, PendingArrange);
 			break;
 		case XA_WM_NORMAL_HINTS:
 			c->hintsvalid = 0;
 			break;
 		case XA_WM_HINTS:
 			updatewmhints(c);
-			drawbars();
+			defer(NULL, PendingDraw);
 			break;
 		}
 		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
 			updatetitle(c);
 			if (c == c->mon->sel)
-				drawbar(c->mon);
+				defer(c->mon, PendingDraw);
 		}
 		if (ev->atom == netatom[NetWMWindowType])
 			updatewindowtype(c);
@@ -1115,10 +1894,12 @@ resizeclient(Client *c, int x, int y, int w, int h)
 	c->oldy = c->y; c->y = wc.y = y;
 	c->oldw = c->w; c->w = wc.width = w;
 	c->oldh = c->h; c->h = wc.height = h;
+	if (!c->iconic) /* still unmapped, showclient() has to map it */
+		c->shown = 1;
 	wc.border_width = c->bw;
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
 	configure(c);
-	XSync(dpy, False);
+	needflush = 1;
 }
 
 void
@@ -1162,6 +1943,7 @@ resizemouse(const Arg *arg)
 			}
 			if (!selmon->lt[selmon->sellt]->arrange || c->isfloating)
 				resize(c, c->x, c->y, nw, nh, 1);
+			flushbatch(); /* bar of a togglefloating() above, once due */
 			break;
 		case KeyPress:
 			break;
@@ -1171,6 +1953,7 @@ resizemouse(const Arg *arg)
 		default:
 			if(handler[ev.type])
 				handler[ev.type](&ev);
+			flushbatch();
 		}
 	} while (grabbing);
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w + c->bw - 1, c->h + c->bw - 1);
@@ -1187,64 +1970,180 @@ void
 restack(Monitor *m)
 {
 	Client *c;
-	XEvent ev;
 	XWindowChanges wc;
 
-	drawbar(m);
+	defer(m, PendingDraw);
 	if (!m->sel)
 		return;
+	/* crossing events generated by the requests below carry their
+	 * serials; enternotify() drops those without a sync barrier, still
+	 * counting from an earlier restack() whose events did not arrive yet */
+	if (enterfirst > enterlast)
+		enterfirst = NextRequest(dpy);
 	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
 		XRaiseWindow(dpy, m->sel->win);
 	if (m->lt[m->sellt]->arrange) {
 		wc.stack_mode = Below;
 		wc.sibling = m->barwin;
-		for (c = m->stack; c; c = c->snext)
-			if (!c->isfloating && ISVISIBLE(c)) {
+		for (c = m->vstack; c; c = c->vsnext)
+			if (!c->isfloating) {
 				XConfigureWindow(dpy, c->win, CWSibling|CWStackMode, &wc);
 				wc.sibling = c->win;
 			}
 	}
-	XSync(dpy, False);
-	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	enterlast = NextRequest(dpy) - 1;
+	/* real crossings from now on carry this serial or a later one */
+	XNoOp(dpy);
+	needflush = 1;
+}
+
+/* FNV-1a over class and instance */
+unsigned int
+rulehash(const char *class, const char *instance)
+{
+	unsigned int h = 2166136261u;
+
+	for (; *class; class++)
+		h = (h ^ (unsigned char)*class) * 16777619u;
+	h *= 16777619u; /* separator */
+	for (; *instance; instance++)
+		h = (h ^ (unsigned char)*instance) * 16777619u;
+	return h;
 }
 
 void
 run(void)
 {
-	XEvent ev;
+	static XEvent ev[BATCHSIZE];
+	int i, n;
+
 	/* main event loop */
 	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+	while (running) {
+		if (!waitevent()) {
+			if (chordexpired())
+				endchord();
+			flushbatch();
+			XFlush(dpy);
+			continue;
+		}
+		if (XNextEvent(dpy, &ev[0]))
+			break;
+		/* drain what is already queued and handle it as one batch; a
+		 * binding may grab and read the events after its button or key
+		 * itself, as movemouse() does, so those end the batch */
+		for (n = 1; n < BATCHSIZE && ev[n - 1].type != ButtonPress
+		     && ev[n - 1].type != KeyPress && XPending(dpy); n++)
+			XNextEvent(dpy, &ev[n]);
+		coalesce(ev, n);
+		for (i = 0; i < n && running; i++)
+			if (ev[i].type && handler[ev[i].type])
+				handler[ev[i].type](&ev[i]); /* call handler */
+		flushbatch();
+	}
 }
 
 void
 scan(void)
 {
-	unsigned int i, num;
+	unsigned int i, num, trans;
 	Window d1, d2, *wins = NULL;
-	XWindowAttributes wa;
+	Monitor *m;
+	ScanWin *si;
 
-	if (XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
+	if (!XQueryTree(dpy, root, &d1, &d2, &wins, &num))
+		return;
+	si = ecalloc(num ? num : 1, sizeof(ScanWin));
+	scanwins(wins, si, num);
+	/* manage without arranging or drawing anything, then settle the
+	 * layout and focus once at the end */
+	adopting = 1;
+	for (trans = 0; trans < 2; trans++) /* transients last */
 		for (i = 0; i < num; i++) {
-			if (!XGetWindowAttributes(dpy, wins[i], &wa)
-			|| wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1))
+			if (!si[i].valid || si[i].wa.override_redirect || si[i].istrans != trans)
 				continue;
-			if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
-				manage(wins[i], &wa);
+			if (si[i].wa.map_state == IsViewable || si[i].state == IconicState)
+				manage(wins[i], &si[i].wa);
 		}
-		for (i = 0; i < num; i++) { /* now the transients */
-			if (!XGetWindowAttributes(dpy, wins[i], &wa))
-				continue;
-			if (XGetTransientForHint(dpy, wins[i], &d1)
-			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
-				manage(wins[i], &wa);
+	adopting = 0;
+	for (m = mons; m; m = m->next)
+		arrange(m);
+	focus(NULL);
+	free(si);
+	if (wins)
+		XFree(wins);
+}
+
+#ifdef XCB
+/* read attributes, geometry, WM_TRANSIENT_FOR and WM_STATE of all windows
+ * with every request in flight before the first reply is awaited */
+void
+scanwins(Window *wins, ScanWin *si, unsigned int n)
+{
+	xcb_get_window_attributes_cookie_t *ac;
+	xcb_get_geometry_cookie_t *gc;
+	xcb_get_property_cookie_t *tc, *sc;
+	xcb_get_window_attributes_reply_t *a;
+	xcb_get_geometry_reply_t *g;
+	xcb_get_property_reply_t *r;
+	uint32_t *v;
+	unsigned int i;
+
+	if (!n)
+		return;
+	ac = ecalloc(n, sizeof(*ac));
+	gc = ecalloc(n, sizeof(*gc));
+	tc = ecalloc(n, sizeof(*tc));
+	sc = ecalloc(n, sizeof(*sc));
+	for (i = 0; i < n; i++) {
+		ac[i] = xcb_get_window_attributes(xcon, wins[i]);
+		gc[i] = xcb_get_geometry(xcon, wins[i]);
+		tc[i] = xcb_get_property(xcon, 0, wins[i], XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+		sc[i] = xcb_get_property(xcon, 0, wins[i], wmatom[WMState], wmatom[WMState], 0, 2);
+	}
+	for (i = 0; i < n; i++) {
+		a = xcb_get_window_attributes_reply(xcon, ac[i], NULL);
+		g = xcb_get_geometry_reply(xcon, gc[i], NULL);
+		if ((si[i].valid = a && g)) {
+			si[i].wa.x = g->x;
+			si[i].wa.y = g->y;
+			si[i].wa.width = g->width;
+			si[i].wa.height = g->height;
+			si[i].wa.border_width = g->border_width;
+			si[i].wa.depth = g->depth;
+			si[i].wa.root = g->root;
+			si[i].wa.class = a->_class;
+			si[i].wa.map_state = a->map_state;
+			si[i].wa.override_redirect = a->override_redirect;
 		}
-		if (wins)
-			XFree(wins);
+		free(a);
+		free(g);
+		r = xcb_get_property_reply(xcon, tc[i], NULL);
+		si[i].istrans = propvalue(r, XA_WINDOW, 32, 1) != NULL;
+		free(r);
+		r = xcb_get_property_reply(xcon, sc[i], NULL);
+		si[i].state = (v = propvalue(r, wmatom[WMState], 32, 1)) ? (long)v[0] : -1;
+		free(r);
+	}
+	free(ac);
+	free(gc);
+	free(tc);
+	free(sc);
+}
+#else
+void
+scanwins(Window *wins, ScanWin *si, unsigned int n)
+{
+	unsigned int i;
+	Window d;
+
+	for (i = 0; i < n; i++) {
+		si[i].valid = XGetWindowAttributes(dpy, wins[i], &si[i].wa);
+		si[i].istrans = XGetTransientForHint(dpy, wins[i], &d) != 0;
+		si[i].state = si[i].valid && si[i].wa.map_state != IsViewable ? getstate(wins[i]) : -1;
 	}
 }
+#endif /* XCB */
 
 void
 sendmon(Client *c, Monitor *m)
@@ -1312,9 +2211,8 @@ void
 setfullscreen(Client *c, int fullscreen)
 {
 	if (fullscreen && !c->isfullscreen) {
-		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-			PropModeReplace, (unsigned char*)&netatom[NetWMFullscreen], 1);
 		c->isfullscreen = 1;
+		updatenetstate(c);
 		c->oldstate = c->isfloating;
 		c->oldbw = c->bw;
 		c->bw = 0;
@@ -1322,9 +2220,8 @@ setfullscreen(Client *c, int fullscreen)
 		resizeclient(c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
 		XRaiseWindow(dpy, c->win);
 	} else if (!fullscreen && c->isfullscreen){
-		XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-			PropModeReplace, (unsigned char*)0, 0);
 		c->isfullscreen = 0;
+		updatenetstate(c);
 		c->isfloating = c->oldstate;
 		c->bw = c->oldbw;
 		c->x = c->oldx;
@@ -1336,6 +2233,29 @@ setfullscreen(Client *c, int fullscreen)
 	}
 }
 
+void
+seticonic(Client *c, int iconic)
+{
+	c->iconic = iconic;
+	setclientstate(c, iconic ? IconicState : NormalState);
+	updatenetstate(c);
+}
+
+/* isurgent must only change through here once c is attached */
+void
+setisurgent(Client *c, int urg)
+{
+	int attached = c->prev || (c->mon && c->mon->clients == c);
+
+	if (c->isurgent == !!urg)
+		return;
+	if (attached)
+		counttags(c, -1);
+	c->isurgent = urg;
+	if (attached)
+		counttags(c, 1);
+}
+
 void
 setlayout(const Arg *arg)
 {
@@ -1347,7 +2267,7 @@ setlayout(const Arg *arg)
 	if (selmon->sel)
 		arrange(selmon);
 	else
-		drawbar(selmon);
+		defer(selmon, PendingDraw);
 }
 
 /* arg > 1.0 will set mfact absolutely */
@@ -1365,6 +2285,82 @@ setmfact(const Arg *arg)
 	arrange(selmon);
 }
 
+/* switch to the key bindings of mode arg->i, 0 being the top level */
+void
+setmode(const Arg *arg)
+{
+	int mode = arg->i >= 0 && arg->i < currentconfig->modescount ? arg->i : 0;
+
+	if (mode == curmode)
+		return;
+	curmode = mode;
+	grabkeys();
+}
+
+void
+setsizehints(Client *c, XSizeHints *size)
+{
+	if (size->flags & PBaseSize) {
+		c->basew = size->base_width;
+		c->baseh = size->base_height;
+	} else if (size->flags & PMinSize) {
+		c->basew = size->min_width;
+		c->baseh = size->min_height;
+	} else
+		c->basew = c->baseh = 0;
+	if (size->flags & PResizeInc) {
+		c->incw = size->width_inc;
+		c->inch = size->height_inc;
+	} else
+		c->incw = c->inch = 0;
+	if (size->flags & PMaxSize) {
+		c->maxw = size->max_width;
+		c->maxh = size->max_height;
+	} else
+		c->maxw = c->maxh = 0;
+	if (size->flags & PMinSize) {
+		c->minw = size->min_width;
+		c->minh = size->min_height;
+	} else if (size->flags & PBaseSize) {
+		c->minw = size->base_width;
+		c->minh = size->base_height;
+	} else
+		c->minw = c->minh = 0;
+	if (size->flags & PAspect) {
+		c->mina = (float)size->min_aspect.y / size->min_aspect.x;
+		c->maxa = (float)size->max_aspect.x / size->max_aspect.y;
+	} else
+		c->maxa = c->mina = 0.0;
+	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
+	c->hashints = c->basew || c->baseh || c->incw || c->inch
+		|| c->maxw || c->maxh || c->minw || c->minh
+		|| c->mina > 0 || c->maxa > 0;
+	c->hintsvalid = 1;
+}
+
+/* like setisurgent(), but also moves c out of the view if necessary */
+void
+settags(Client *c, unsigned int tags)
+{
+	counttags(c, -1);
+	c->tags = tags;
+	counttags(c, 1);
+	if (!ISVISIBLE(c)) {
+		detachview(c);
+		detachvstack(c);
+	} else if (!c->vprev && c->mon->vis != c)
+		updateview(c->mon); /* order of the view is that of clients */
+}
+
+void
+settitle(Client *c, const char *name)
+{
+	strncpy(c->name, name, sizeof c->name - 1);
+	c->name[sizeof c->name - 1] = '\0';
+	if (c->name[0] == '\0') /* hack to mark broken clients */
+		strcpy(c->name, broken);
+}
+
 void
 setup(void)
 {
@@ -1387,9 +2383,14 @@ setup(void)
 	sw = DisplayWidth(dpy, screen);
 	sh = DisplayHeight(dpy, screen);
 	root = RootWindow(dpy, screen);
+#ifdef XCB
+	if (!(xcon = XGetXCBConnection(dpy)))
+		die("dwm: cannot get xcb connection");
+#endif /* XCB */
 	drw = drw_create(dpy, screen, root, sw, sh);
 	if (!drw_fontset_create(drw, currentconfig->appearance.fonts, currentconfig->appearance.fontscount))
 		die("no fonts could be loaded.");
+	drw_fallback_load(drw, fallbackpath);
 	lrpad = drw->fonts->h;
 	bh = drw->fonts->h + 2;
 	updategeom();
@@ -1405,6 +2406,7 @@ setup(void)
 	netatom[NetWMState] = XInternAtom(dpy, "_NET_WM_STATE", False);
 	netatom[NetWMCheck] = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False);
 	netatom[NetWMFullscreen] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+	netatom[NetWMHidden] = XInternAtom(dpy, "_NET_WM_STATE_HIDDEN", False);
 	netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
 	netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
@@ -1438,6 +2440,7 @@ setup(void)
 		|LeaveWindowMask|StructureNotifyMask|PropertyChangeMask;
 	XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa);
 	XSelectInput(dpy, root, wa.event_mask);
+	updatenumlockmask();
 	grabkeys();
 	focus(NULL);
 }
@@ -1447,7 +2450,7 @@ seturgent(Client *c, int urg)
 {
 	XWMHints *wmh;
 
-	c->isurgent = urg;
+	setisurgent(c, urg);
 	if (!(wmh = XGetWMHints(dpy, c->win)))
 		return;
 	wmh->flags = urg ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
@@ -1456,21 +2459,60 @@ seturgent(Client *c, int urg)
 }
 
 void
-showhide(Client *c)
+setwindowtype(Client *c, Atom state, Atom wtype)
 {
-	if (!c)
+	if (state == netatom[NetWMFullscreen])
+		setfullscreen(c, 1);
+	if (wtype == netatom[NetWMWindowTypeDialog])
+		c->isfloating = 1;
+}
+
+void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (!wmh)
 		return;
-	if (ISVISIBLE(c)) {
-		/* show clients top down */
-		XMoveWindow(dpy, c->win, c->x, c->y);
-		if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) && !c->isfullscreen)
+	if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints(dpy, c->win, wmh);
+	} else
+		setisurgent(c, (wmh->flags & XUrgencyHint) ? 1 : 0);
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
+void
+showclient(Client *c)
+{
+	XMoveWindow(dpy, c->win, c->x, c->y);
+	if (c->iconic) {
+		XMapWindow(dpy, c->win);
+		seticonic(c, 0);
+	}
+	c->shown = 1;
+}
+
+void
+showhide(Monitor *m)
+{
+	Client *c, *last = NULL;
+
+	/* show clients top down */
+	for (c = m->stack; c; c = c->snext) {
+		last = c;
+		if (!ISVISIBLE(c))
+			continue;
+		if (!c->shown)
+			showclient(c);
+		if ((!m->lt[m->sellt]->arrange || c->isfloating) && !c->isfullscreen)
 			resize(c, c->x, c->y, c->w, c->h, 0);
-		showhide(c->snext);
-	} else {
-		/* hide clients bottom up */
-		showhide(c->snext);
-		XMoveWindow(dpy, c->win, WIDTH(c) * -2, c->y);
 	}
+	/* hide clients bottom up */
+	for (c = last; c; c = c->sprev)
+		if (!ISVISIBLE(c) && c->shown)
+			hideclient(c);
 }
 
 void
@@ -1493,11 +2535,22 @@ spawn(const Arg *arg)
 	}
 }
 
+/* keys typed while a chord is pending go to dwm only, see keypress() */
+void
+startchord(const KeyNode *level)
+{
+	if (XGrabKeyboard(dpy, root, False, GrabModeAsync, GrabModeAsync,
+	    CurrentTime) != GrabSuccess)
+		return;
+	chord = level;
+	chordstart = msnow();
+}
+
 void
 tag(const Arg *arg)
 {
 	if (selmon->sel && arg->ui & TAGMASK) {
-		selmon->sel->tags = arg->ui & TAGMASK;
+		settags(selmon->sel, arg->ui & TAGMASK);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -1511,19 +2564,14 @@ tagmon(const Arg *arg)
 	sendmon(selmon->sel, dirtomon(arg->i));
 }
 
-void 
-resize_arrange(Client *c, int x, int y, int w, int h)
-{
-	resize(c, x, y, w - (2 * c->bw), h - (2 * c->bw), 0);
-}
-
 void
 tile(Monitor *m)
 {
 	unsigned int i, n, h, mw, my, ty;
+	const Geom *g;
 	Client *c;
 
-	for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++);
+	for (n = 0, c = nexttiled(m->vis); c; c = nexttiled(c->vnext), n++);
 	if (n == 0)
 		return;
 
@@ -1531,21 +2579,21 @@ tile(Monitor *m)
 		mw = m->nmaster ? m->ww * m->mfact : 0;
 	else
 		mw = m->ww;
-	for (i = my = ty = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+	for (i = my = ty = 0, c = nexttiled(m->vis); c; c = nexttiled(c->vnext), i++)
 		if (i < m->nmaster) {
 			h = (m->wh - my) / (MIN(n, m->nmaster) - i) - 2 * currentconfig->appearance.gappx;
 
-			resize_arrange(c, m->wx + currentconfig->appearance.gappx, m->wy + my + currentconfig->appearance.gappx, mw - 2 * currentconfig->appearance.gappx, h);
+			g = place(c, m->wx + currentconfig->appearance.gappx, m->wy + my + currentconfig->appearance.gappx, mw - 2 * currentconfig->appearance.gappx, h);
 
-			if (my + HEIGHT(c) < m->wh)
-				my += HEIGHT(c) + 2 * currentconfig->appearance.gappx;
+			if (my + g->h + 2 * c->bw < m->wh)
+				my += g->h + 2 * c->bw + 2 * currentconfig->appearance.gappx;
 		} else {
 			h = (m->wh - ty) / (n - i) - 2 * currentconfig->appearance.gappx;
 
-			resize_arrange(c, m->wx + mw + currentconfig->appearance.gappx, m->wy + ty + currentconfig->appearance.gappx, m->ww - mw - 2 * currentconfig->appearance.gappx, h);
+			g = place(c, m->wx + mw + currentconfig->appearance.gappx, m->wy + ty + currentconfig->appearance.gappx, m->ww - mw - 2 * currentconfig->appearance.gappx, h);
 
-			if (ty + HEIGHT(c) < m->wh)
-				ty += HEIGHT(c) + 2 * currentconfig->appearance.gappx;
+			if (ty + g->h + 2 * c->bw < m->wh)
+				ty += g->h + 2 * c->bw + 2 * currentconfig->appearance.gappx;
 		}
 }
 
@@ -1581,7 +2629,7 @@ toggletag(const Arg *arg)
 		return;
 	newtags = selmon->sel->tags ^ (arg->ui & TAGMASK);
 	if (newtags) {
-		selmon->sel->tags = newtags;
+		settags(selmon->sel, newtags);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -1594,6 +2642,7 @@ toggleview(const Arg *arg)
 
 	if (newtagset) {
 		selmon->tagset[selmon->seltags] = newtagset;
+		updateview(selmon);
 		focus(NULL);
 		arrange(selmon);
 	}
@@ -1618,6 +2667,7 @@ unmanage(Client *c, int destroyed)
 	Monitor *m = c->mon;
 	XWindowChanges wc;
 
+	wintabdel(c->win);
 	detach(c);
 	detachstack(c);
 	if (!destroyed) {
@@ -1632,7 +2682,7 @@ unmanage(Client *c, int destroyed)
 		XSetErrorHandler(xerror);
 		XUngrabServer(dpy);
 	}
-	free(c);
+	poolfree(&clientpool, c);
 	focus(NULL);
 	updateclientlist();
 	arrange(m);
@@ -1647,6 +2697,8 @@ unmapnotify(XEvent *e)
 	if ((c = wintoclient(ev->window))) {
 		if (ev->send_event)
 			setclientstate(c, WithdrawnState);
+		else if (c->ignoreunmap > 0)
+			c->ignoreunmap--;
 		else
 			unmanage(c, 0);
 	}
@@ -1663,11 +2715,22 @@ updatebars(void)
 	};
 	XClassHint ch = {"dwm", "dwm"};
 	for (m = mons; m; m = m->next) {
+		if (m->barpixw != m->ww) {
+			if (m->barpix) {
+				drw_deldrawable(drw, m->barpix);
+				XFreePixmap(dpy, m->barpix);
+			}
+			m->barpix = XCreatePixmap(dpy, root, m->ww, bh, DefaultDepth(dpy, screen));
+			drw_adddrawable(drw, m->barpix);
+			m->barpixw = m->ww;
+			m->barvalid = 0;
+		}
 		if (m->barwin)
 			continue;
 		m->barwin = XCreateWindow(dpy, root, m->wx, m->by, m->ww, bh, 0, DefaultDepth(dpy, screen),
 				CopyFromParent, DefaultVisual(dpy, screen),
 				CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+		wintabadd(m->barwin, NULL, m);
 		XDefineCursor(dpy, m->barwin, cursor[CurNormal]->cursor);
 		XMapRaised(dpy, m->barwin);
 		XSetClassHint(dpy, m->barwin, &ch);
@@ -1749,7 +2812,7 @@ updategeom(void)
 			for (m = mons; m && m->next; m = m->next);
 			while ((c = m->clients)) {
 				dirty = 1;
-				m->clients = c->next;
+				detach(c);
 				detachstack(c);
 				c->mon = mons;
 				attach(c);
@@ -1776,9 +2839,44 @@ updategeom(void)
 		selmon = mons;
 		selmon = wintomon(root);
 	}
+	updatemonnums();
 	return dirty;
 }
 
+void
+updatemonnums(void)
+{
+	Monitor *m;
+	int n;
+
+	for (n = 0, m = mons; m; m = m->next)
+		n = MAX(n, m->num + 1);
+	if (n != nmonbynum) {
+		free(monbynum);
+		monbynum = ecalloc(n, sizeof(Monitor *));
+		nmonbynum = n;
+	} else
+		memset(monbynum, 0, n * sizeof(Monitor *));
+	for (m = mons; m; m = m->next)
+		monbynum[m->num] = m;
+	flushrulecache(); /* entries hold monitor numbers */
+}
+
+/* _NET_WM_STATE as far as dwm manages it */
+void
+updatenetstate(Client *c)
+{
+	Atom state[2];
+	int n = 0;
+
+	if (c->isfullscreen)
+		state[n++] = netatom[NetWMFullscreen];
+	if (c->iconic)
+		state[n++] = netatom[NetWMHidden];
+	XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
+		PropModeReplace, (unsigned char *)state, n);
+}
+
 void
 updatenumlockmask(void)
 {
@@ -1804,39 +2902,7 @@ updatesizehints(Client *c)
 	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
-	if (size.flags & PBaseSize) {
-		c->basew = size.base_width;
-		c->baseh = size.base_height;
-	} else if (size.flags & PMinSize) {
-		c->basew = size.min_width;
-		c->baseh = size.min_height;
-	} else
-		c->basew = c->baseh = 0;
-	if (size.flags & PResizeInc) {
-		c->incw = size.width_inc;
-		c->inch = size.height_inc;
-	} else
-		c->incw = c->inch = 0;
-	if (size.flags & PMaxSize) {
-		c->maxw = size.max_width;
-		c->maxh = size.max_height;
-	} else
-		c->maxw = c->maxh = 0;
-	if (size.flags & PMinSize) {
-		c->minw = size.min_width;
-		c->minh = size.min_height;
-	} else if (size.flags & PBaseSize) {
-		c->minw = size.base_width;
-		c->minh = size.base_height;
-	} else
-		c->minw = c->minh = 0;
-	if (size.flags & PAspect) {
-		c->mina = (float)size.min_aspect.y / size.min_aspect.x;
-		c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
-	} else
-		c->maxa = c->mina = 0.0;
-	c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
-	c->hintsvalid = 1;
+	setsizehints(c, &size);
 }
 
 void
@@ -1844,7 +2910,8 @@ updatestatus(void)
 {
 	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)))
 		strcpy(stext, "dwm-"VERSION);
-	drawbar(selmon);
+	stextw = TEXTW(stext);
+	defer(selmon, PendingDraw);
 }
 
 void
@@ -1856,16 +2923,40 @@ updatetitle(Client *c)
 		strcpy(c->name, broken);
 }
 
+/* rebuild the lists of visible clients after the tagset of m changed */
 void
-updatewindowtype(Client *c)
+updateview(Monitor *m)
 {
-	Atom state = getatomprop(c, netatom[NetWMState]);
-	Atom wtype = getatomprop(c, netatom[NetWMWindowType]);
+	Client *c, *t;
 
-	if (state == netatom[NetWMFullscreen])
-		setfullscreen(c, 1);
-	if (wtype == netatom[NetWMWindowTypeDialog])
-		c->isfloating = 1;
+	m->vis = m->vstack = NULL;
+	for (t = NULL, c = m->clients; c; c = c->next) {
+		c->vnext = c->vprev = NULL;
+		if (!ISVISIBLE(c))
+			continue;
+		if ((c->vprev = t))
+			t->vnext = c;
+		else
+			m->vis = c;
+		t = c;
+	}
+	for (t = NULL, c = m->stack; c; c = c->snext) {
+		c->vsnext = c->vsprev = NULL;
+		if (!ISVISIBLE(c))
+			continue;
+		if ((c->vsprev = t))
+			t->vsnext = c;
+		else
+			m->vstack = c;
+		t = c;
+	}
+}
+
+void
+updatewindowtype(Client *c)
+{
+	setwindowtype(c, getatomprop(c, netatom[NetWMState]),
+		getatomprop(c, netatom[NetWMWindowType]));
 }
 
 void
@@ -1874,15 +2965,7 @@ updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
@@ -1895,37 +2978,130 @@ view(const Arg *arg)
 	selmon->seltags ^= 1; /* toggle sel tagset */
 	if (arg->ui & TAGMASK)
 		selmon->tagset[selmon->seltags] = arg->ui & TAGMASK;
+	updateview(selmon);
 	focus(NULL);
 	arrange(selmon);
 }
 
-Client *
-wintoclient(Window w)
+/* wait for the next event, but no longer than until the pending chord
+ * expires or the deferred bar redraws are due; false if that came first */
+int
+waitevent(void)
 {
-	Client *c;
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	long long left = -1, t;
 	Monitor *m;
 
-	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			if (c->win == w)
-				return c;
+	if (XPending(dpy))
+		return 1;
+	if (chord && currentconfig->lsettings.chordtimeout > 0)
+		left = MAX(0, chordstart + currentconfig->lsettings.chordtimeout - msnow());
+	for (m = mons; m && !(m->pending & PendingDraw); m = m->next);
+	if (m) {
+		t = frameleft();
+		left = left < 0 ? t : MIN(left, t);
+	}
+	return left < 0 || poll(&pfd, 1, left) > 0;
+}
+
+static unsigned int
+winhash(Window w)
+{
+	unsigned int h = (unsigned int)w;
+
+	h = ((h >> 16) ^ h) * 0x45D9F3B;
+	h = ((h >> 16) ^ h) * 0x45D9F3B;
+	return (h >> 16) ^ h;
+}
+
+void
+wintabadd(Window w, Client *c, Monitor *m)
+{
+	WinEntry *old;
+	unsigned int i, n, mask;
+
+	if (!w)
+		return;
+	if ((wintabused + 1) * 2 > wintabsize) {
+		/* keep the load factor below 1/2 so probe runs stay short */
+		old = wintab;
+		n = wintabsize;
+		wintabsize = n ? n * 2 : 64;
+		wintab = ecalloc(wintabsize, sizeof(WinEntry));
+		mask = wintabsize - 1;
+		while (n--)
+			if (old[n].win) {
+				for (i = winhash(old[n].win) & mask; wintab[i].win; i = (i + 1) & mask);
+				wintab[i] = old[n];
+			}
+		free(old);
+	}
+	mask = wintabsize - 1;
+	for (i = winhash(w) & mask; wintab[i].win && wintab[i].win != w; i = (i + 1) & mask);
+	if (!wintab[i].win)
+		wintabused++;
+	wintab[i].win = w;
+	wintab[i].c = c;
+	wintab[i].m = m;
+}
+
+void
+wintabdel(Window w)
+{
+	WinEntry *e;
+	unsigned int i, j, k, mask;
+
+	if (!(e = wintabget(w)))
+		return;
+	mask = wintabsize - 1;
+	i = j = e - wintab;
+	/* backward shift deletion: move up every entry of the probe run that
+	 * would become unreachable once slot i is emptied */
+	for (j = (j + 1) & mask; wintab[j].win; j = (j + 1) & mask) {
+		k = winhash(wintab[j].win) & mask;
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			wintab[i] = wintab[j];
+			i = j;
+		}
+	}
+	wintab[i].win = None;
+	wintab[i].c = NULL;
+	wintab[i].m = NULL;
+	wintabused--;
+}
+
+WinEntry *
+wintabget(Window w)
+{
+	unsigned int i, mask;
+
+	if (!w || !wintabsize)
+		return NULL;
+	mask = wintabsize - 1;
+	for (i = winhash(w) & mask; wintab[i].win; i = (i + 1) & mask)
+		if (wintab[i].win == w)
+			return &wintab[i];
 	return NULL;
 }
 
+Client *
+wintoclient(Window w)
+{
+	WinEntry *e;
+
+	return (e = wintabget(w)) ? e->c : NULL;
+}
+
 Monitor *
 wintomon(Window w)
 {
 	int x, y;
-	Client *c;
-	Monitor *m;
+	WinEntry *e;
 
 	if (w == root && getrootptr(&x, &y))
 		return recttomon(x, y, 1, 1);
-	for (m = mons; m; m = m->next)
-		if (w == m->barwin)
-			return m;
-	if ((c = wintoclient(w)))
-		return c->mon;
+	if ((e = wintabget(w)))
+		return e->c ? e->c->mon : e->m;
 	return selmon;
 }
 
@@ -1972,7 +3148,7 @@ zoom(const Arg *arg)
 
 	if (!selmon->lt[selmon->sellt]->arrange || !c || c->isfloating)
 		return;
-	if (c == nexttiled(selmon->clients) && !(c = nexttiled(c->next)))
+	if (c == nexttiled(selmon->vis) && !(c = nexttiled(c->vnext)))
 		return;
 	pop(c);
 }
@@ -1981,12 +3157,16 @@ void
 restart(const Arg *arg)
 {
 	loadconfig(configpath);
-	free(drw);
+	drw_fallback_save(drw, fallbackpath);
+	drw_free(drw);
 
 	drw = drw_create(dpy, screen, root, sw, sh);
 	if (!drw_fontset_create(drw, currentconfig->appearance.fonts, currentconfig->appearance.fontscount))
 		die("no fonts could be loaded.");
+	drw_fallback_load(drw, fallbackpath);
 
+	for (int i = 0; i < LASTScheme; i++)
+		free(scheme[i]);
 	free(scheme);
 	scheme = ecalloc(LASTScheme, sizeof(Clr *));
 	for (int i = 0; i < LASTScheme; i++)
@@ -1994,6 +3174,8 @@ restart(const Arg *arg)
 
 	updatebars();
 	updatestatus();
+	curmode = 0; /* the modes may have changed */
+	grabkeys();
 
 	Client *c;
 	Monitor *m;
@@ -2003,11 +3185,15 @@ restart(const Arg *arg)
 			c->oldbw = c->bw;
 			c->bw = currentconfig->appearance.borderpx;
 			XSetWindowBorder(dpy, c->w, scheme[SchemeNorm][ColBorder].pixel);
+			c->buttons = ButtonsNone; /* the button bindings may have changed */
+			grabbuttons(c, 0);
 			configure(c);
 			updatesizehints(c);
 			updatewmhints(c);
 			XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
+			c->shown = 0; /* off screen now, let showhide() move it back */
 		}
+		m->barvalid = 0; /* the fonts and colors may have changed */
 		arrange(m);
 	}
 
@@ -2018,11 +3204,18 @@ int
 main(int argc, char *argv[])
 {
 	char defaultpath[256];
+	const char *cachedir;
 	configpath = getenv("DWM_CONFIG_PATH");
 	if(!configpath) {
 		snprintf(defaultpath, sizeof(defaultpath), "%s/.config/dwm/config", getenv("HOME"));
 		configpath = defaultpath; // i am aware, we don't need to care about it (for now)
 	}
+	cachedir = getenv("XDG_CACHE_HOME");
+	if (cachedir && *cachedir)
+		snprintf(fallbackpath, sizeof(fallbackpath), "%s/dwm", cachedir);
+	else
+		snprintf(fallbackpath, sizeof(fallbackpath), "%s/.cache/dwm", getenv("HOME"));
+	strncat(fallbackpath, "/fallback", sizeof(fallbackpath) - strlen(fallbackpath) - 1);
 
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("dwm-"VERSION);
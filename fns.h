@@ -1,37 +1,59 @@
-void applyrules(Client *c);
+void applyrules(Client *c, const char *class, const char *instance);
 int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 void arrange(Monitor *m);
 void arrangemon(Monitor *m);
 void attach(Client *c);
 void attachstack(Client *c);
+int barcell(BarCell *cell, int full, int x, int w, int scm, unsigned int flags, const char *text);
 void buttonpress(XEvent *e);
 void checkotherwm(void);
+int chordexpired(void);
 void cleanup(void);
 void cleanupmon(Monitor *mon);
 void clientmessage(XEvent *e);
+void commitgeom(Monitor *m);
 void configure(Client *c);
+void counttags(Client *c, int dir);
 void configurenotify(XEvent *e);
 void configurerequest(XEvent *e);
+void coalesce(XEvent *ev, int n);
+int copytextprop(XTextProperty *name, char *text, unsigned int size);
 Monitor *createmon(void);
+void defer(Monitor *m, unsigned int what);
 void destroynotify(XEvent *e);
 void detach(Client *c);
 void detachstack(Client *c);
+void detachview(Client *c);
+void detachvstack(Client *c);
 Monitor *dirtomon(int dir);
 void drawbar(Monitor *m);
-void drawbars(void);
+void dumpstats(const Arg *arg);
+void endchord(void);
 void enternotify(XEvent *e);
 void expose(XEvent *e);
+void fetchprops(Window w, Props *p);
+void flushbatch(void);
+void flushrequests(void);
+void flushrulecache(void);
 void focus(Client *c);
 void focusin(XEvent *e);
 void focusmon(const Arg *arg);
 void focusstack(const Arg *arg);
+long long frameleft(void);
 Atom getatomprop(Client *c, Atom prop);
+Window getevwin(XEvent *e);
 int getrootptr(int *x, int *y);
 long getstate(Window w);
+Atom getwinatomprop(Window w, Atom prop);
 int gettextprop(Window w, Atom atom, char *text, unsigned int size);
 void grabbuttons(Client *c, int focused);
+int grabcmp(const void *a, const void *b);
+void grabkey(const Grab *g, int grab);
 void grabkeys(void);
+void hideclient(Client *c);
 void incnmaster(const Arg *arg);
+int keymapcmp(const void *a, const void *b);
+unsigned int keymapfind(const KeyMap *map, unsigned int n, KeySym sym);
 void keypress(XEvent *e);
 void killclient(const Arg *arg);
 void manage(Window w, XWindowAttributes *wa);
@@ -40,29 +62,42 @@ void maprequest(XEvent *e);
 void monocle(Monitor *m);
 void motionnotify(XEvent *e);
 void movemouse(const Arg *arg);
+long long msnow(void);
 Client *nexttiled(Client *c);
+const Geom *place(Client *c, int x, int y, int w, int h);
 void pop(Client *c);
 void propertynotify(XEvent *e);
 void quit(const Arg *arg);
 Monitor *recttomon(int x, int y, int w, int h);
 void resize(Client *c, int x, int y, int w, int h, int interact);
-void resize_arrange(Client *c, int x, int y, int w, int h);
 void resizeclient(Client *c, int x, int y, int w, int h);
 void resizemouse(const Arg *arg);
 void restack(Monitor *m);
+unsigned int rulehash(const char *class, const char *instance);
 void run(void);
 void scan(void);
+void scanwins(Window *wins, ScanWin *si, unsigned int n);
 int sendevent(Client *c, Atom proto);
 void sendmon(Client *c, Monitor *m);
 void setclientstate(Client *c, long state);
 void setfocus(Client *c);
 void setfullscreen(Client *c, int fullscreen);
+void seticonic(Client *c, int iconic);
+void setisurgent(Client *c, int urg);
 void setlayout(const Arg *arg);
 void setmfact(const Arg *arg);
+void setmode(const Arg *arg);
+void setsizehints(Client *c, XSizeHints *size);
+void settags(Client *c, unsigned int tags);
+void settitle(Client *c, const char *name);
 void setup(void);
 void seturgent(Client *c, int urg);
-void showhide(Client *c);
+void setwindowtype(Client *c, Atom state, Atom wtype);
+void setwmhints(Client *c, XWMHints *wmh);
+void showclient(Client *c);
+void showhide(Monitor *m);
 void spawn(const Arg *arg);
+void startchord(const KeyNode *level);
 void tag(const Arg *arg);
 void tagmon(const Arg *arg);
 void tile(Monitor *m);
@@ -77,13 +112,20 @@ void updatebarpos(Monitor *m);
 void updatebars(void);
 void updateclientlist(void);
 int updategeom(void);
+void updatenetstate(Client *c);
+void updatemonnums(void);
 void updatenumlockmask(void);
 void updatesizehints(Client *c);
 void updatestatus(void);
 void updatetitle(Client *c);
+void updateview(Monitor *m);
 void updatewindowtype(Client *c);
 void updatewmhints(Client *c);
 void view(const Arg *arg);
+int waitevent(void);
+void wintabadd(Window w, Client *c, Monitor *m);
+void wintabdel(Window w);
+WinEntry *wintabget(Window w);
 Client *wintoclient(Window w);
 Monitor *wintomon(Window w);
 int xerror(Display *dpy, XErrorEvent *ee);
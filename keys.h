@@ -5,6 +5,14 @@ typedef struct {
 	int error;
 } KeySymbol;
 
+#define KEYCHORDMAX 4 /* keys in a chord such as "super + w ; s" */
+
+typedef struct {
+	KeySymbol keys[KEYCHORDMAX];
+	int len;
+	int error;
+} KeyChord;
+
 typedef struct {
 	unsigned int mod;
 	int button;
@@ -12,4 +20,5 @@ typedef struct {
 } ButtonSymbol;
 
 KeySymbol parse_keysymbol(const char *format);
+KeyChord parse_keychord(const char *format);
 ButtonSymbol parse_buttonsymbol(const char *format);
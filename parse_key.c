@@ -2,9 +2,9 @@
 #include <X11/Xlib.h>
 #include <X11/keysym.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include "utils.h"
 #include "keys.h"
 
 #define LENGTH(X) (sizeof (X) / sizeof (X)[0])
@@ -18,6 +18,9 @@
  * <keysymbol> ::= <modseq> <key> <EOL>
  *              | <key> <EOL>
  *
+ * <keychord> ::= <keychord> ';' <keysymbol>
+ *             | <keysymbol>
+ *
  * <modseq> ::= <modseq> <mod> '+'
  *            | <mod> '+'
  * 
@@ -75,6 +78,45 @@ parse_keysymbol(const char *format)
 	return k;
 }
 
+KeyChord
+parse_keychord(const char *format)
+{
+	KeyChord c = {0};
+
+	for(;;) {
+		while(isblank(*format))
+			format++;
+
+		const char *end = strchr(format, ';');
+		if(!end)
+			end = format + strlen(format);
+
+		if(c.len == KEYCHORDMAX) {
+			c.error = 1;
+			return c;
+		}
+
+		int size = end - format;
+		char *step;
+		if(!(step = malloc(size + 1))) {
+			c.error = 1;
+			return c;
+		}
+		memcpy(step, format, size);
+		step[size] = 0;
+		c.keys[c.len] = parse_keysymbol(step);
+		free(step);
+
+		if(c.keys[c.len++].error) {
+			c.error = 1;
+			return c;
+		}
+		if(*end == 0)
+			return c;
+		format = end + 1;
+	}
+}
+
 ButtonSymbol
 parse_buttonsymbol(const char *format)
 {
@@ -147,7 +189,7 @@ parse_key(StateMachine *m)
 {
 	const char *ss = m->s;
 
-	while((*ss) != 0 && !isblank(*ss)) 
+	while((*ss) != 0 && !isblank(*ss) && (*ss) != ';') 
 		ss++;
 	
 	int size = ss - m->s;
@@ -19,6 +19,20 @@ static struct
 	{ "p", .r = { .mod = 0, .sym = XK_p } },
 };
 
+static struct
+{
+	const char *str;
+	KeyChord r;
+} chord_test[] = {
+	{ "p", .r = { .len = 1, .keys = { { .mod = 0, .sym = XK_p } } } },
+	{ "super + w ; s", .r = { .len = 2, .keys = { { .mod = Mod4Mask, .sym = XK_w }, { .mod = 0, .sym = XK_s } } } },
+	{ "super+w;shift+s", .r = { .len = 2, .keys = { { .mod = Mod4Mask, .sym = XK_w }, { .mod = ShiftMask, .sym = XK_s } } } },
+	{ "ctrl + x ; ctrl + c ; k", .r = { .len = 3, .keys = { { .mod = ControlMask, .sym = XK_x }, { .mod = ControlMask, .sym = XK_c }, { .mod = 0, .sym = XK_k } } } },
+	{ "super + w ;", .r = { .error = 1 } },
+	{ "; s", .r = { .error = 1 } },
+	{ "a ; b ; c ; d ; e", .r = { .error = 1 } },
+};
+
 static struct
 {
 	const char *str;
@@ -73,5 +87,28 @@ main()
 		}
 	}
 
+	for(int i = 0; i < LENGTH(chord_test); i++) {
+		KeyChord rr = parse_keychord(chord_test[i].str);
+
+		if(rr.error != chord_test[i].r.error) {
+			printf("%d: chord %s\n", i, rr.error ? "error" : "should fail");
+			return 1;
+		}
+		if(rr.error)
+			continue;
+
+		if(rr.len != chord_test[i].r.len) {
+			printf("%d: wrong chord length\n", i);
+			return 1;
+		}
+
+		for(int j = 0; j < rr.len; j++)
+			if(rr.keys[j].mod != chord_test[i].r.keys[j].mod
+			|| rr.keys[j].sym != chord_test[i].r.keys[j].sym) {
+				printf("%d: wrong chord key %d\n", i, j);
+				return 1;
+			}
+	}
+
 	return 0;
 }
@@ -0,0 +1,226 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Rule matching compiled into one Aho-Corasick automaton per field, so that
+ * a window is matched against all rules in a single pass over each of its
+ * class, instance and title. A rule matches if each of its patterns is a
+ * substring of the corresponding field, exactly as with strstr(). */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "rules.h"
+
+#define WORDBITS      (sizeof(unsigned long) * CHAR_BIT)
+#define WORDS(n)      (((n) + WORDBITS - 1) / WORDBITS)
+#define SETBIT(s, i)  ((s)[(i) / WORDBITS] |= 1UL << ((i) % WORDBITS))
+
+typedef struct {
+	int rule;
+	int next;             /* next rule ending in the same state, or -1 */
+} Out;
+
+typedef struct {
+	unsigned char col[256]; /* byte -> column of delta, 0 for bytes in no pattern */
+	int ncols;
+	int nstates;
+	int *delta;           /* nstates * ncols, complete transition function */
+	int *out;             /* first Out of each state, or -1 */
+	int *dict;            /* nearest proper suffix state with outputs, or 0 */
+	Out *outs;
+	int nouts;
+	unsigned long *need;  /* rules with a pattern on this field */
+} Automaton;
+
+struct RuleSet {
+	int n;
+	int words;
+	Automaton a[RuleFields];
+	unsigned long *hit;   /* scratch */
+	unsigned long *set;   /* result of rules_match() */
+	int needtitle;        /* see rules_needtitle() */
+};
+
+static void *
+erealloc(void *p, size_t size)
+{
+	if (!(p = realloc(p, size)))
+		die("realloc:");
+	return p;
+}
+
+static int
+newstate(Automaton *a, int *cap)
+{
+	int i, s = a->nstates++;
+
+	if (s == *cap) {
+		*cap *= 2;
+		a->delta = erealloc(a->delta, *cap * a->ncols * sizeof(int));
+		a->out = erealloc(a->out, *cap * sizeof(int));
+	}
+	for (i = 0; i < a->ncols; i++)
+		a->delta[s * a->ncols + i] = -1;
+	a->out[s] = -1;
+	return s;
+}
+
+static void
+build(Automaton *a, const char *(*pats)[RuleFields], int n, int f, int words)
+{
+	const unsigned char *p;
+	int cap = 16, i, c, s, t, u, head, tail, *fail, *queue;
+
+	/* columns for the bytes that occur in some pattern */
+	a->ncols = 1;
+	for (i = 0; i < n; i++)
+		for (p = (const unsigned char *)pats[i][f]; p && *p; p++)
+			if (!a->col[*p])
+				a->col[*p] = a->ncols++;
+
+	a->need = ecalloc(words, sizeof(unsigned long));
+	a->delta = ecalloc(cap * a->ncols, sizeof(int));
+	a->out = ecalloc(cap, sizeof(int));
+	a->outs = ecalloc(n ? n : 1, sizeof(Out));
+	newstate(a, &cap);
+
+	/* trie */
+	for (i = 0; i < n; i++) {
+		if (!pats[i][f])
+			continue;
+		SETBIT(a->need, i);
+		for (s = 0, p = (const unsigned char *)pats[i][f]; *p; p++) {
+			c = a->col[*p];
+			if ((t = a->delta[s * a->ncols + c]) < 0) {
+				t = newstate(a, &cap);
+				a->delta[s * a->ncols + c] = t;
+			}
+			s = t;
+		}
+		a->outs[a->nouts].rule = i;
+		a->outs[a->nouts].next = a->out[s];
+		a->out[s] = a->nouts++;
+	}
+
+	/* failure links in breadth first order, completing delta on the way */
+	fail = ecalloc(a->nstates, sizeof(int));
+	queue = ecalloc(a->nstates, sizeof(int));
+	a->dict = ecalloc(a->nstates, sizeof(int));
+	head = tail = 0;
+	for (c = 0; c < a->ncols; c++) {
+		if ((t = a->delta[c]) < 0)
+			a->delta[c] = 0;
+		else
+			queue[tail++] = t;
+	}
+	while (head < tail) {
+		s = queue[head++];
+		for (c = 0; c < a->ncols; c++) {
+			u = a->delta[fail[s] * a->ncols + c];
+			if ((t = a->delta[s * a->ncols + c]) < 0) {
+				a->delta[s * a->ncols + c] = u;
+				continue;
+			}
+			fail[t] = u;
+			a->dict[t] = a->out[u] >= 0 ? u : a->dict[u];
+			queue[tail++] = t;
+		}
+	}
+	free(fail);
+	free(queue);
+}
+
+RuleSet *
+rules_compile(const char *(*pats)[RuleFields], int n)
+{
+	RuleSet *rs;
+	int f;
+
+	rs = ecalloc(1, sizeof(RuleSet));
+	rs->n = n;
+	rs->words = WORDS(n) ? WORDS(n) : 1;
+	for (f = 0; f < RuleFields; f++)
+		build(&rs->a[f], pats, n, f, rs->words);
+	rs->hit = ecalloc(rs->words, sizeof(unsigned long));
+	rs->set = ecalloc(rs->words, sizeof(unsigned long));
+	return rs;
+}
+
+static void
+emit(const Automaton *a, int s, unsigned long *hit)
+{
+	int o;
+
+	for (o = a->out[s]; o >= 0; o = a->outs[o].next)
+		SETBIT(hit, a->outs[o].rule);
+}
+
+/* returns the set of matching rules, valid until the next call */
+const unsigned long *
+rules_match(RuleSet *rs, const char *subj[RuleFields])
+{
+	const unsigned char *p;
+	const Automaton *a;
+	int f, i, s, t;
+
+	for (i = 0; i < rs->words; i++)
+		rs->set[i] = ~0UL;
+	for (f = 0; f < RuleFields; f++) {
+		a = &rs->a[f];
+		if (f == RuleTitle) /* set holds the rules matching the other fields */
+			for (rs->needtitle = i = 0; i < rs->words; i++)
+				rs->needtitle |= (rs->set[i] & a->need[i]) != 0;
+		memset(rs->hit, 0, rs->words * sizeof(unsigned long));
+		emit(a, 0, rs->hit); /* empty patterns */
+		for (s = 0, p = (const unsigned char *)(subj[f] ? subj[f] : ""); *p; p++) {
+			s = a->delta[s * a->ncols + a->col[*p]];
+			for (t = a->out[s] >= 0 ? s : a->dict[s]; t; t = a->dict[t])
+				emit(a, t, rs->hit);
+		}
+		for (i = 0; i < rs->words; i++)
+			rs->set[i] &= ~a->need[i] | rs->hit[i];
+	}
+	return rs->set;
+}
+
+/* whether the last rules_match() result depended on the title: some rule
+ * with a title pattern matched on class and instance */
+int
+rules_needtitle(const RuleSet *rs)
+{
+	return rs->needtitle;
+}
+
+/* index of the first rule in set at or after i, or -1 */
+int
+rules_next(const RuleSet *rs, const unsigned long *set, int i)
+{
+	for (; i < rs->n; i++) {
+		if (!(set[i / WORDBITS] >> (i % WORDBITS))) {
+			i |= WORDBITS - 1; /* rest of the word is empty */
+			continue;
+		}
+		if (set[i / WORDBITS] & 1UL << (i % WORDBITS))
+			return i;
+	}
+	return -1;
+}
+
+void
+rules_free(RuleSet *rs)
+{
+	int f;
+
+	if (!rs)
+		return;
+	for (f = 0; f < RuleFields; f++) {
+		free(rs->a[f].delta);
+		free(rs->a[f].out);
+		free(rs->a[f].dict);
+		free(rs->a[f].outs);
+		free(rs->a[f].need);
+	}
+	free(rs->hit);
+	free(rs->set);
+	free(rs);
+}
@@ -0,0 +1,12 @@
+/* See LICENSE file for copyright and license details. */
+
+/* the fields a rule can match on; a NULL pattern matches anything */
+enum { RuleClass, RuleInstance, RuleTitle, RuleFields };
+
+typedef struct RuleSet RuleSet;
+
+RuleSet *rules_compile(const char *(*pats)[RuleFields], int n);
+const unsigned long *rules_match(RuleSet *rs, const char *subj[RuleFields]);
+int rules_needtitle(const RuleSet *rs);
+int rules_next(const RuleSet *rs, const unsigned long *set, int i);
+void rules_free(RuleSet *rs);
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "rules.h"
+
+#define LENGTH(X) (sizeof (X) / sizeof (X)[0])
+
+static const char *rules[][RuleFields] = {
+	/* class        instance     title */
+	{ "st-256color", NULL,       NULL      },
+	{ "Firefox",    NULL,        NULL      },
+	{ "fox",        "Navigator", NULL      },
+	{ NULL,         NULL,        "Event Tester" },
+	{ "xev",        NULL,        "Event Tester" },
+	{ "Gimp",       NULL,        ""        },
+	{ "a",          "aa",        "aaa"     },
+	{ "he",         "she",       "hers"    },
+	{ "",           NULL,        NULL      },
+};
+
+static struct
+{
+	const char *subj[RuleFields];
+} test_table[] = {
+	{ { "st-256color", "st-256color", "zsh" } },
+	{ { "Firefox", "Navigator", "Mozilla Firefox" } },
+	{ { "Firefox", "Toolkit", "Event Tester" } },
+	{ { "xev", "xev", "Event Tester" } },
+	{ { "xev", "xev", "zsh" } },
+	{ { "Gimp", "gimp", NULL } },
+	{ { "aaaa", "baab", "xaaay" } },
+	{ { "ushers", "ushers", "ushers" } },
+	{ { "usher", "she", "hers" } },
+	{ { NULL, NULL, NULL } },
+	{ { "", "", "" } },
+};
+
+/* the semantics rules_match() must preserve, see applyrules() */
+static int
+matches(const char *const *r, const char *const *subj, int fields)
+{
+	for (int f = 0; f < fields; f++)
+		if (r[f] && !strstr(subj[f] ? subj[f] : "", r[f]))
+			return 0;
+	return 1;
+}
+
+int
+main()
+{
+	RuleSet *rs = rules_compile(rules, LENGTH(rules));
+
+	for(int i = 0; i < LENGTH(test_table); i++) {
+		const unsigned long *set = rules_match(rs, test_table[i].subj);
+		int next = rules_next(rs, set, 0);
+		int needtitle = 0;
+
+		for(int j = 0; j < LENGTH(rules); j++) {
+			int want = matches(rules[j], test_table[i].subj, RuleFields);
+
+			if(rules[j][RuleTitle] && matches(rules[j], test_table[i].subj, RuleTitle))
+				needtitle = 1;
+
+			if(want != (next == j)) {
+				printf("%d: rule %d %s\n", i, j, want ? "missed" : "matched");
+				return 1;
+			}
+			if(next == j)
+				next = rules_next(rs, set, j + 1);
+		}
+		if(next != -1) {
+			printf("%d: stray rule %d\n", i, next);
+			return 1;
+		}
+		if(needtitle != rules_needtitle(rs)) {
+			printf("%d: wrong needtitle\n", i);
+			return 1;
+		}
+	}
+
+	rules_free(rs);
+	return 0;
+}
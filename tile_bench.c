@@ -0,0 +1,300 @@
+/* tile_bench - time tile() and showhide() over synthetic clients
+ *
+ * Compares the Client of dat.h, which keeps what layouts touch in front,
+ * against the former order that put the 256 byte title before the
+ * geometry, hints, tags and links. Client goes through tile(), place(),
+ * applysizehints() and showhide() of dwm.c itself; the old order through
+ * a copy of those functions that differs only in the struct it reads.
+ * Both come from a Pool and sit on the lists of the same monitor, half
+ * the clients on a hidden tag in between, which showhide() has to walk
+ * past. No X server is needed, nothing past arrange() is run. */
+#define main dwm_main
+#include "dwm.c"
+#undef main
+
+#define ROUNDS 200
+
+typedef struct Fat Fat;
+struct Fat {
+	char name[256];
+	float mina, maxa;
+	int x, y, w, h;
+	int oldx, oldy, oldw, oldh;
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh, hintsvalid, hashints;
+	int bw, oldbw;
+	unsigned int tags;
+	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
+	int shown, iconic, buttons, ignoreunmap;
+	Fat *next, *prev;
+	Fat *snext, *sprev;
+	Fat *vnext, *vprev;
+	Fat *vsnext, *vsprev;
+	Monitor *mon;
+	Window win;
+};
+
+typedef struct {
+	Fat *c;
+	int x, y, w, h;
+} FatGeom;
+
+static Config cfg = { .appearance = { .borderpx = 1, .gappx = 4 },
+                      .lsettings = { .mfact = 0.55, .nmaster = 1, .resizehints = 1 } };
+static FatGeom *fatgeom;
+static unsigned int nfatgeom, fatgeomsize;
+
+/* applysizehints(), place(), nexttiled(), tile() and showhide() of dwm.c
+ * over Fat, showclient() and hideclient() are never reached */
+static int
+fatapplysizehints(Fat *c, int *x, int *y, int *w, int *h)
+{
+	int baseismin;
+	Monitor *m = c->mon;
+
+	*w = MAX(1, *w);
+	*h = MAX(1, *h);
+	if (*x >= m->wx + m->ww)
+		*x = m->wx + m->ww - (c->w + 2 * c->bw);
+	if (*y >= m->wy + m->wh)
+		*y = m->wy + m->wh - (c->h + 2 * c->bw);
+	if (*x + *w + 2 * c->bw <= m->wx)
+		*x = m->wx;
+	if (*y + *h + 2 * c->bw <= m->wy)
+		*y = m->wy;
+	if (*h < bh)
+		*h = bh;
+	if (*w < bh)
+		*w = bh;
+	if (currentconfig->lsettings.resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange) {
+		if (!c->hintsvalid)
+			c->hintsvalid = 1;
+		if (!c->hashints)
+			return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
+		baseismin = c->basew == c->minw && c->baseh == c->minh;
+		if (!baseismin) {
+			*w -= c->basew;
+			*h -= c->baseh;
+		}
+		if (c->mina > 0 && c->maxa > 0) {
+			if (c->maxa < (float)*w / *h)
+				*w = *h * c->maxa + 0.5;
+			else if (c->mina < (float)*h / *w)
+				*h = *w * c->mina + 0.5;
+		}
+		if (baseismin) {
+			*w -= c->basew;
+			*h -= c->baseh;
+		}
+		if (c->incw)
+			*w -= *w % c->incw;
+		if (c->inch)
+			*h -= *h % c->inch;
+		*w = MAX(*w + c->basew, c->minw);
+		*h = MAX(*h + c->baseh, c->minh);
+		if (c->maxw)
+			*w = MIN(*w, c->maxw);
+		if (c->maxh)
+			*h = MIN(*h, c->maxh);
+	}
+	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
+}
+
+static const FatGeom *
+fatplace(Fat *c, int x, int y, int w, int h)
+{
+	FatGeom *g;
+
+	w -= 2 * c->bw;
+	h -= 2 * c->bw;
+	fatapplysizehints(c, &x, &y, &w, &h);
+	if (nfatgeom == fatgeomsize) {
+		fatgeomsize = fatgeomsize ? fatgeomsize * 2 : 16;
+		if (!(fatgeom = realloc(fatgeom, fatgeomsize * sizeof(FatGeom))))
+			die("realloc:");
+	}
+	g = &fatgeom[nfatgeom++];
+	g->c = c;
+	g->x = x; g->y = y; g->w = w; g->h = h;
+	return g;
+}
+
+static Fat *
+fatnexttiled(Fat *c)
+{
+	for (; c && c->isfloating; c = c->vnext);
+	return c;
+}
+
+static void
+fattile(Monitor *m, Fat *vis)
+{
+	unsigned int i, n, h, mw, my, ty;
+	const FatGeom *g;
+	Fat *c;
+
+	for (n = 0, c = fatnexttiled(vis); c; c = fatnexttiled(c->vnext), n++);
+	if (n == 0)
+		return;
+
+	if (n > m->nmaster)
+		mw = m->nmaster ? m->ww * m->mfact : 0;
+	else
+		mw = m->ww;
+	for (i = my = ty = 0, c = fatnexttiled(vis); c; c = fatnexttiled(c->vnext), i++)
+		if (i < m->nmaster) {
+			h = (m->wh - my) / (MIN(n, m->nmaster) - i) - 2 * currentconfig->appearance.gappx;
+
+			g = fatplace(c, m->wx + currentconfig->appearance.gappx, m->wy + my + currentconfig->appearance.gappx, mw - 2 * currentconfig->appearance.gappx, h);
+
+			if (my + g->h + 2 * c->bw < m->wh)
+				my += g->h + 2 * c->bw + 2 * currentconfig->appearance.gappx;
+		} else {
+			h = (m->wh - ty) / (n - i) - 2 * currentconfig->appearance.gappx;
+
+			g = fatplace(c, m->wx + mw + currentconfig->appearance.gappx, m->wy + ty + currentconfig->appearance.gappx, m->ww - mw - 2 * currentconfig->appearance.gappx, h);
+
+			if (ty + g->h + 2 * c->bw < m->wh)
+				ty += g->h + 2 * c->bw + 2 * currentconfig->appearance.gappx;
+		}
+}
+
+static void
+fatshowhide(Monitor *m, Fat *stack)
+{
+	Fat *c, *last = NULL;
+
+	for (c = stack; c; c = c->snext) {
+		last = c;
+		if (!(c->tags & m->tagset[m->seltags]))
+			continue;
+		if (!c->shown)
+			die("tile_bench: showclient");
+		if ((!m->lt[m->sellt]->arrange || c->isfloating) && !c->isfullscreen)
+			die("tile_bench: resize");
+	}
+	for (c = last; c; c = c->sprev)
+		if (!(c->tags & m->tagset[m->seltags]) && c->shown)
+			die("tile_bench: hideclient");
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+bench(unsigned int n)
+{
+	Pool fatpool = { sizeof(Fat), 64 };
+	Monitor *m = createmon();
+	Client *c;
+	Fat *f, *fatvis = NULL, *fatstack = NULL;
+	unsigned int i, r;
+	double t0, tfat, tnew, sfat, snew;
+
+	m->ww = sw = 1920;
+	m->wh = sh = 1080;
+	/* alternate the two kinds the way manage() would, every fourth one
+	 * with terminal style increments */
+	for (i = 0; i < n; i++) {
+		f = poolalloc(&fatpool);
+		f->tags = 1 << (i % 2);
+		f->bw = cfg.appearance.borderpx;
+		f->hintsvalid = 1;
+		if (i % 4 == 0) {
+			f->hashints = 1;
+			f->basew = f->baseh = 2;
+			f->incw = 7;
+			f->inch = 15;
+		}
+		f->mon = m;
+		f->snext = fatstack;
+		if (fatstack)
+			fatstack->sprev = f;
+		fatstack = f;
+		if (f->tags & m->tagset[m->seltags]) {
+			f->shown = 1;
+			f->vnext = fatvis;
+			if (fatvis)
+				fatvis->vprev = f;
+			fatvis = f;
+		}
+
+		c = poolalloc(&clientpool);
+		c->tags = 1 << (i % 2);
+		c->bw = cfg.appearance.borderpx;
+		c->hintsvalid = 1;
+		if (i % 4 == 0) {
+			c->hashints = 1;
+			c->basew = c->baseh = 2;
+			c->incw = 7;
+			c->inch = 15;
+		}
+		c->mon = m;
+		c->shown = ISVISIBLE(c);
+		attach(c);
+		attachstack(c);
+	}
+
+	/* one untimed pass each so that neither starts out cold */
+	fattile(m, fatvis);
+	tile(m);
+
+	t0 = now();
+	for (r = 0; r < ROUNDS; r++) {
+		nfatgeom = 0;
+		fattile(m, fatvis);
+	}
+	tfat = now() - t0;
+
+	t0 = now();
+	for (r = 0; r < ROUNDS; r++) {
+		m->ngeom = 0;
+		tile(m);
+	}
+	tnew = now() - t0;
+
+	fatshowhide(m, fatstack);
+	showhide(m);
+
+	t0 = now();
+	for (r = 0; r < ROUNDS; r++)
+		fatshowhide(m, fatstack);
+	sfat = now() - t0;
+
+	t0 = now();
+	for (r = 0; r < ROUNDS; r++)
+		showhide(m);
+	snew = now() - t0;
+
+	if (nfatgeom != m->ngeom)
+		die("tile_bench: %u old vs %u new placements", nfatgeom, m->ngeom);
+	for (i = 0; i < m->ngeom; i++)
+		if (fatgeom[i].x != m->geom[i].x || fatgeom[i].y != m->geom[i].y
+		|| fatgeom[i].w != m->geom[i].w || fatgeom[i].h != m->geom[i].h)
+			die("tile_bench: placement %u differs", i);
+
+	printf("%6u clients: tile() old %8.1f us  new %8.1f us  "
+		"showhide() old %8.1f us  new %8.1f us\n",
+		n, tfat * 1e6 / ROUNDS, tnew * 1e6 / ROUNDS,
+		sfat * 1e6 / ROUNDS, snew * 1e6 / ROUNDS);
+
+	pooldestroy(&fatpool);
+	pooldestroy(&clientpool);
+	free(m->geom);
+	free(m);
+}
+
+int
+main(void)
+{
+	currentconfig = &cfg;
+	bench(1000);
+	bench(10000);
+	free(fatgeom);
+	return 0;
+}
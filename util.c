@@ -7,6 +7,8 @@
 
 #include "util.h"
 
+#define POOLALIGN 16 /* alignment of pool elements and chunk header size */
+
 void
 die(const char *fmt, ...)
 {
@@ -35,3 +37,59 @@ ecalloc(size_t nmemb, size_t size)
 		die("calloc:");
 	return p;
 }
+
+static size_t
+poolstride(Pool *p)
+{
+	return (MAX(p->size, sizeof(void *)) + POOLALIGN - 1) & ~(size_t)(POOLALIGN - 1);
+}
+
+void *
+poolalloc(Pool *p)
+{
+	char *chunk, *e;
+	size_t i, stride = poolstride(p);
+
+	if (!p->free) {
+		chunk = ecalloc(1, POOLALIGN + p->perchunk * stride);
+		*(void **)chunk = p->chunks;
+		p->chunks = chunk;
+		p->nchunks++;
+		/* thread the free list in address order so that consecutive
+		 * allocations end up next to each other */
+		for (i = p->perchunk; i--; ) {
+			e = chunk + POOLALIGN + i * stride;
+			*(void **)e = p->free;
+			p->free = e;
+		}
+	}
+	e = p->free;
+	p->free = *(void **)e;
+	memset(e, 0, stride);
+	if (++p->live > p->peak)
+		p->peak = p->live;
+	return e;
+}
+
+void
+poolfree(Pool *p, void *e)
+{
+	if (!e)
+		return;
+	*(void **)e = p->free;
+	p->free = e;
+	p->live--;
+}
+
+void
+pooldestroy(Pool *p)
+{
+	void *next;
+
+	for (; p->chunks; p->chunks = next) {
+		next = *(void **)p->chunks;
+		free(p->chunks);
+	}
+	p->free = NULL;
+	p->live = p->nchunks = 0;
+}
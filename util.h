@@ -7,3 +7,16 @@
 
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);
+
+/* fixed-size object pool carving elements out of contiguous chunks */
+typedef struct {
+	size_t size;          /* element size */
+	size_t perchunk;      /* elements per chunk */
+	void *chunks;         /* chunk list, linked through the chunk header */
+	void *free;           /* free list, linked through the first word */
+	unsigned int live, peak, nchunks;
+} Pool;
+
+void *poolalloc(Pool *p);
+void poolfree(Pool *p, void *e);
+void pooldestroy(Pool *p);